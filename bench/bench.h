@@ -0,0 +1,207 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * Minimal benchmark runner of sip_bench
+ *
+ * Each benchmark is one operation that is timed in batches until enough time has
+ * passed, the median batch gives ns/op. The global operator new of bench_main.cpp counts
+ * the heap allocations of the timed batches. Benchmarks register themselves with
+ * BENCHMARK(group, name) in their own translation unit.
+ */
+namespace bench {
+
+struct HeapCounters
+{
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+// counted by operator new of bench_main.cpp
+extern HeapCounters heap;
+
+struct Result
+{
+    std::string group;
+    std::string name;
+    uint64_t iterations = 0;
+    double ns_per_op = 0;
+    double allocations_per_op = 0;
+    double bytes_per_op = 0;
+    // optional measurements of the benchmark itself, e.g. latency percentiles
+    std::vector<std::pair<std::string, double>> metrics;
+};
+
+/**
+ * Keep the compiler from dropping a computation whose result is not used
+ */
+template <class T>
+inline void keep(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class Runner
+{
+public:
+    explicit Runner(bool quick)
+    : m_quick(quick)
+    {
+    }
+
+    bool quick() const
+    {
+        return m_quick;
+    }
+
+    /**
+     * Time operation() and record the result, valid until the next measure() or record()
+     */
+    template <class Operation>
+    Result& measure(const char* group, const char* name, Operation&& operation)
+    {
+        using Clock = std::chrono::steady_clock;
+        const double target_ns = m_quick ? 2e6 : 5e7;
+        const int batches = m_quick ? 3 : 7;
+
+        // grow the batch until it runs long enough to be timed
+        uint64_t batch = 1;
+        for (;;)
+        {
+            auto start = Clock::now();
+            for (uint64_t i = 0; i < batch; i++)
+                operation();
+            double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            if (elapsed >= target_ns / batches || batch >= (1ull << 30))
+                break;
+            batch *= elapsed < target_ns / batches / 16 ? 8 : 2;
+        }
+
+        // reserved up front, the sample itself must not show up as an allocation
+        std::vector<double> samples;
+        samples.reserve(batches);
+        HeapCounters before = heap;
+        for (int b = 0; b < batches; b++)
+        {
+            auto start = Clock::now();
+            for (uint64_t i = 0; i < batch; i++)
+                operation();
+            samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / batch);
+        }
+        std::sort(samples.begin(), samples.end());
+
+        Result result;
+        result.group = group;
+        result.name = name;
+        result.iterations = batch * batches;
+        result.ns_per_op = samples[samples.size() / 2];
+        result.allocations_per_op = (double) (heap.allocations - before.allocations) / result.iterations;
+        result.bytes_per_op = (double) (heap.bytes - before.bytes) / result.iterations;
+        m_results.push_back(result);
+        return m_results.back();
+    }
+
+    /**
+     * Time operation() alone, setup() runs untimed before each call to bring the object
+     * back to where operation() starts, e.g. a client that is registered again.
+     * Each call is timed on its own, the cost of reading the clock is subtracted.
+     */
+    template <class Setup, class Operation>
+    Result& measure_steps(const char* group, const char* name, Setup&& setup, Operation&& operation)
+    {
+        using Clock = std::chrono::steady_clock;
+        const uint64_t iterations = m_quick ? 200 : 5000;
+
+        std::vector<double> samples;
+        samples.reserve(iterations);
+        std::vector<double> clock_samples;
+        clock_samples.reserve(iterations);
+        for (uint64_t i = 0; i < iterations; i++)
+        {
+            auto start = Clock::now();
+            auto stop = Clock::now();
+            clock_samples.push_back(std::chrono::duration<double, std::nano>(stop - start).count());
+        }
+        std::sort(clock_samples.begin(), clock_samples.end());
+        double clock_ns = clock_samples[clock_samples.size() / 2];
+
+        HeapCounters counted;
+        for (uint64_t i = 0; i < iterations; i++)
+        {
+            setup();
+            HeapCounters before = heap;
+            auto start = Clock::now();
+            operation();
+            auto stop = Clock::now();
+            counted.allocations += heap.allocations - before.allocations;
+            counted.bytes += heap.bytes - before.bytes;
+            samples.push_back(std::max(0.0, std::chrono::duration<double, std::nano>(stop - start).count() - clock_ns));
+        }
+        std::sort(samples.begin(), samples.end());
+
+        Result result;
+        result.group = group;
+        result.name = name;
+        result.iterations = iterations;
+        result.ns_per_op = samples[samples.size() / 2];
+        result.allocations_per_op = (double) counted.allocations / iterations;
+        result.bytes_per_op = (double) counted.bytes / iterations;
+        m_results.push_back(result);
+        return m_results.back();
+    }
+
+    /**
+     * Record a result that was measured by the benchmark itself
+     */
+    Result& record(const char* group, const char* name)
+    {
+        Result result;
+        result.group = group;
+        result.name = name;
+        m_results.push_back(result);
+        return m_results.back();
+    }
+
+    const std::vector<Result>& results() const
+    {
+        return m_results;
+    }
+
+private:
+    bool m_quick;
+    std::vector<Result> m_results;
+};
+
+using Function = void (*)(Runner&);
+
+struct Registration
+{
+    const char* group;
+    Function function;
+};
+
+inline std::vector<Registration>& registry()
+{
+    static std::vector<Registration> benchmarks;
+    return benchmarks;
+}
+
+struct Registrar
+{
+    Registrar(const char* group, Function function)
+    {
+        registry().push_back({ group, function });
+    }
+};
+
+} // namespace bench
+
+#define BENCHMARK(group, function)                                 \
+    static void function(bench::Runner& runner);                   \
+    static bench::Registrar function##_registrar(group, function); \
+    static void function(bench::Runner& runner)
@@ -0,0 +1,101 @@
+/**
+ * Buffer against the strlen/snprintf LegacyBuffer it replaced, both build the same INVITE
+ * the way the client did before the header fragments were pre-rendered
+ */
+#include "sip_client/buffer.h"
+
+#include "bench.h"
+#include "legacy_buffer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+struct InviteFields
+{
+    std::string user = "620";
+    std::string server_ip = "192.168.178.1";
+    std::string my_ip = "192.168.178.50";
+    std::string uri = "sip:**610@192.168.178.1";
+    std::string caller_display = "Door";
+    std::string realm = "fritz.box";
+    std::string nonce = "7C9E2A41B3D5F687";
+    std::string response = "3b5c5f1d0a7e4e2f9c8d6b4a29180706";
+    uint32_t cseq = 1804289383;
+    uint32_t call_id = 846930886;
+    uint32_t tag = 1681692777;
+    uint32_t branch = 1714636915;
+    uint32_t session_id = 1957747793;
+};
+
+template <class BufferT, class SdpBufferT>
+void build_invite(BufferT& stream, SdpBufferT& sdp, const InviteFields& f)
+{
+    static constexpr uint16_t LOCAL_PORT = 5060;
+    static constexpr uint16_t LOCAL_RTP_PORT = 7078;
+    stream.clear();
+    stream << "INVITE" << " " << f.uri << " SIP/2.0\r\n";
+    stream << "CSeq: " << f.cseq << " " << "INVITE" << "\r\n";
+    stream << "Call-ID: " << f.call_id << "@" << f.my_ip << "\r\n";
+    stream << "Max-Forwards: 70\r\n";
+    stream << "User-Agent: sip-client/0.0.1\r\n";
+    stream << "From: \"" << f.caller_display << "\" <sip:" << f.user << "@" << f.server_ip << ">;tag=" << f.tag << "\r\n";
+    stream << "Via: SIP/2.0/" << "UDP" << " " << f.my_ip << ":" << LOCAL_PORT << ";branch=z9hG4bK-" << f.branch << ";rport\r\n";
+    stream << "To: <" << f.uri << ">\r\n";
+    stream << "Contact: \"" << f.user << "\" <sip:" << f.user << "@" << f.my_ip << ":" << LOCAL_PORT << ";transport=" << "udp" << ">\r\n";
+    stream << "Authorization: Digest username=\"" << f.user << "\", realm=\"" << f.realm << "\", nonce=\"" << f.nonce << "\", uri=\"" << f.uri
+           << "\", response=\"" << f.response << "\"\r\n";
+    stream << "Content-Type: application/sdp\r\n";
+    stream << "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY, MESSAGE, SUBSCRIBE, INFO\r\n";
+    sdp.clear();
+    sdp << "v=0\r\n"
+        << "o=" << f.user << " " << f.session_id << " " << f.session_id << " IN IP4 " << f.my_ip << "\r\n"
+        << "s=sip-client/0.0.1\r\n"
+        << "c=IN IP4 " << f.my_ip << "\r\n"
+        << "t=0 0\r\n"
+        << "m=audio " << LOCAL_RTP_PORT << " RTP/AVP 8 101\r\n"
+        << "a=sendrecv\r\n"
+        << "a=rtpmap:101 telephone-event/8000\r\n"
+        << "a=fmtp:101 0-15\r\n"
+        << "a=ptime:20\r\n";
+    stream << "Content-Length: " << (uint32_t) sdp.size() << "\r\n";
+    stream << "\r\n";
+    stream << sdp.data();
+}
+
+} // namespace
+
+BENCHMARK("buffer", buffer_invite)
+{
+    InviteFields fields;
+    LegacyBuffer<2048> legacy;
+    LegacyBuffer<512> legacy_sdp;
+    TxBufferT current;
+    Buffer<512> current_sdp;
+
+    // both must produce the same bytes, otherwise the comparison is meaningless
+    build_invite(legacy, legacy_sdp, fields);
+    build_invite(current, current_sdp, fields);
+    if (std::string(legacy.data()) != std::string(current.data(), current.size()))
+    {
+        printf("LegacyBuffer and Buffer built different messages\n");
+        exit(1);
+    }
+    double message_bytes = (double) current.size();
+
+    auto& before = runner.measure("buffer", "INVITE with LegacyBuffer", [&] {
+        build_invite(legacy, legacy_sdp, fields);
+        bench::keep(legacy.data()[0]);
+    });
+    before.metrics.push_back({ "message_bytes", message_bytes });
+    double before_ns = before.ns_per_op;
+
+    auto& after = runner.measure("buffer", "INVITE with Buffer", [&] {
+        build_invite(current, current_sdp, fields);
+        bench::keep(current.size());
+    });
+    after.metrics.push_back({ "message_bytes", message_bytes });
+    after.metrics.push_back({ "speedup", before_ns / after.ns_per_op });
+}
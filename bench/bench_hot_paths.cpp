@@ -0,0 +1,155 @@
+/**
+ * Hot paths of the SIP client: parsing what the FRITZ!Box sends, building the
+ * REGISTER and INVITE, the digest response and the MD5 below it
+ *
+ * The client is driven through its public API only. Building a request is timed as the
+ * run() that sends it into a link that is down, the digest response as the difference
+ * between an authenticated request and the same request of a client that was never
+ * challenged.
+ */
+#include "sip_client/mbedtls_md5.h"
+#include "sip_client/sip_client.h"
+#include "sip_client/sip_packet.h"
+
+#include "bench.h"
+#include "fritzbox_corpus.h"
+#include "sim_network.h"
+#include "sip_server.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using SipClientIntT = SipClientInt<SimUdpClient, MbedtlsMd5, SimClock>;
+
+BENCHMARK("parse", parse_fritzbox_corpus)
+{
+    for (auto& entry : fritzbox_corpus::ALL)
+    {
+        std::string name = std::string("SipPacket::parse ") + entry.name;
+        auto& result = runner.measure("parse", name.c_str(), [&] {
+            SipPacket packet(entry.message.data(), entry.message.size());
+            bool parsed = packet.parse();
+            bench::keep(parsed);
+            bench::keep(packet.get_status_code());
+        });
+        result.metrics.push_back({ "message_bytes", (double) entry.message.size() });
+    }
+}
+
+/**
+ * Client registered at the stand-in, with qop=auth challenges or without any.
+ * Between the timed steps the link is down and everything sent is dropped right away.
+ */
+struct ClientFixture
+{
+    explicit ClientFixture(bool challenged)
+    {
+        target.prepare("**610", "192.168.1.1");
+        server.config.qop = true;
+        if (!challenged)
+            server.config.register_challenge = SipServerStandIn::Challenge::NONE;
+        register_again();
+    }
+
+    /**
+     * Start over with a registered client and all dialogs free, the challenge is kept
+     */
+    void register_again()
+    {
+        network.set_down(false);
+        client.stop();
+        client.init();
+        for (int i = 0; i < 1000 && !client.isReadyToCall(); i++)
+            step();
+        if (!client.isReadyToCall())
+        {
+            printf("The client did not register at the stand-in\n");
+            exit(1);
+        }
+        network.set_down(true);
+    }
+
+    /**
+     * Forget the registration, the next run() sends a REGISTER
+     */
+    void unregister()
+    {
+        client.stop();
+        client.init();
+    }
+
+    void ring()
+    {
+        if (client.request_ring(target, "Door") < 0)
+        {
+            printf("The client did not accept the call\n");
+            exit(1);
+        }
+        client.run();
+    }
+
+    /**
+     * Size of the datagrams sent by send()
+     */
+    template <class Send>
+    double message_bytes(Send&& send)
+    {
+        auto before = network.to_server.stats().sent_bytes;
+        send();
+        return (double) (network.to_server.stats().sent_bytes - before);
+    }
+
+    void step()
+    {
+        network.now++;
+        client.run();
+        network.exchange(server);
+    }
+
+    SimNetwork network;
+    SipServerStandIn server;
+    SipClientIntT client{ "620", "secret", "192.168.1.1", "5060", "192.168.1.50" };
+    SipCallTarget target;
+};
+
+BENCHMARK("build", build_messages)
+{
+    double register_ns[2];
+    double invite_ns[2];
+    for (bool challenged : { false, true })
+    {
+        ClientFixture fixture(challenged);
+        const char* suffix = challenged ? ", qop=auth" : ", no challenge";
+
+        std::string name = std::string("REGISTER") + suffix;
+        fixture.unregister();
+        double bytes = fixture.message_bytes([&] { fixture.client.run(); });
+        auto& reg = runner.measure_steps("build", name.c_str(), [&] { fixture.unregister(); }, [&] { fixture.client.run(); });
+        reg.metrics.push_back({ "message_bytes", bytes });
+        register_ns[challenged] = reg.ns_per_op;
+
+        name = std::string("INVITE") + suffix;
+        fixture.register_again();
+        bytes = fixture.message_bytes([&] { fixture.ring(); });
+        auto& invite = runner.measure_steps("build", name.c_str(), [&] { fixture.register_again(); }, [&] { fixture.ring(); });
+        invite.metrics.push_back({ "message_bytes", bytes });
+        invite_ns[challenged] = invite.ns_per_op;
+    }
+
+    // what the digest response and the Authorization header add to a request
+    runner.record("digest", "digest response of REGISTER qop=auth").metrics.push_back({ "ns_per_request", register_ns[1] - register_ns[0] });
+    runner.record("digest", "digest response of INVITE qop=auth").metrics.push_back({ "ns_per_request", invite_ns[1] - invite_ns[0] });
+}
+
+BENCHMARK("digest", digest)
+{
+    // the inputs of the response hash with qop=auth: HA1:nonce:nc:cnonce:auth:HA2
+    static const char input[] = "8b3d4c0e5a6f7182939a4b5c6d7e8f90:5E3A1C0FFEE:00000001:1a2b3c4d:auth:0f1e2d3c4b5a69788796a5b4c3d2e1f0";
+    unsigned char hash[16];
+    auto& md5 = runner.measure("digest", "mbedtls_l_md5 response input", [&] {
+        mbedtls_l_md5((const unsigned char*) input, sizeof(input) - 1, hash);
+        bench::keep(hash[0]);
+    });
+    md5.metrics.push_back({ "input_bytes", (double) (sizeof(input) - 1) });
+}
@@ -0,0 +1,183 @@
+/**
+ * Time from request_ring() until the authenticated INVITE reaches the gateway
+ *
+ * The client talks to the stand-in over UDP on localhost, every call is challenged with
+ * a fresh nonce, so the time includes the round trip of the 401. "before" runs the same
+ * client behind a socket that emulates the 200 ms receive window the client had until
+ * every datagram was handled on arrival.
+ */
+#include "sip_client/mbedtls_md5.h"
+#include "sip_client/posix_udp_client.h"
+#include "sip_client/sip_client.h"
+
+#include "bench.h"
+#include "sim_network.h"
+#include "sip_server.h"
+#include "udp_loopback.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+static constexpr uint16_t SERVER_PORT = 15060;
+static constexpr unsigned long RECEIVE_WINDOW_MS = 200;
+
+/**
+ * The former rx(): received data was only parsed when the 200 ms window ended and
+ * tx() did nothing while a window was open. Datagrams show up at the end of the window,
+ * requests sent while it is open leave when it ends.
+ */
+template <size_t RX_SLOTS = RX_QUEUE_SLOTS, size_t RX_SIZE = RX_SLOT_SIZE>
+class AccumulatingUdpClientT : public PosixUdpClientT<RX_SLOTS, RX_SIZE>
+{
+    using Base = PosixUdpClientT<RX_SLOTS, RX_SIZE>;
+
+public:
+    template <size_t SLOTS, size_t SIZE>
+    using WithRing = AccumulatingUdpClientT<SLOTS, SIZE>;
+
+    using Base::Base;
+
+    bool has_pending()
+    {
+        auto now = millis();
+        if (m_sending)
+        {
+            // the pass after the window ended may send, then the next window starts
+            m_sending = false;
+            m_window_started = now;
+        }
+        if (now - m_window_started < RECEIVE_WINDOW_MS)
+            return false;
+        flush();
+        if (Base::has_pending())
+            return true;
+        m_sending = true;
+        return false;
+    }
+
+    bool send_buffered_data()
+    {
+        if (m_sending || m_queued == m_queue.size())
+            return Base::send_buffered_data();
+        m_queue[m_queued].clear();
+        m_queue[m_queued] << m_tx->view();
+        m_queued++;
+        return true;
+    }
+
+    TxBufferT& get_new_tx_buf()
+    {
+        m_tx = &Base::get_new_tx_buf();
+        return *m_tx;
+    }
+
+private:
+    void flush()
+    {
+        for (size_t i = 0; i < m_queued; i++)
+        {
+            Base::get_new_tx_buf() << m_queue[i].view();
+            Base::send_buffered_data();
+        }
+        m_queued = 0;
+    }
+
+    unsigned long m_window_started = 0;
+    bool m_sending = false;
+    TxBufferT* m_tx = nullptr;
+    std::array<TxBufferT, 4> m_queue;
+    size_t m_queued = 0;
+};
+
+using AccumulatingUdpClient = AccumulatingUdpClientT<>;
+
+struct Latencies
+{
+    std::vector<double> samples;
+
+    double percentile(double p)
+    {
+        if (samples.empty())
+            return -1;
+        std::sort(samples.begin(), samples.end());
+        return samples[std::min(samples.size() - 1, (size_t) (p * samples.size()))];
+    }
+};
+
+/**
+ * Ring, wait for the authenticated INVITE at the stand-in and cancel, calls times
+ */
+template <class SocketT>
+Latencies measure_calls(int calls)
+{
+    using Clock = std::chrono::steady_clock;
+    SipServerStandIn server;
+    server.config.new_nonce_per_call = true;
+    UdpLoopback<SipServerStandIn> loopback(server);
+    SipClient<SocketT, MbedtlsMd5> client("620", "secret", "127.0.0.1", std::to_string(SERVER_PORT), "127.0.0.1");
+    bool cancelled = false;
+    client.set_event_handler([&](const SipClientEvent& event) { cancelled |= event.event != SipClientEvent::Event::BUTTON_PRESS; });
+
+    Latencies latencies;
+    if (!loopback.open(SERVER_PORT) || !client.init())
+    {
+        printf("Failed to open the loopback sockets\n");
+        return latencies;
+    }
+    auto pass = [&] {
+        client.run();
+        loopback.exchange(millis());
+    };
+    auto run_until = [&](auto done, unsigned long timeout_ms) {
+        auto start = millis();
+        while (!done() && millis() - start < timeout_ms)
+            pass();
+        return done();
+    };
+    SimRandom random(17);
+
+    run_until([&] { return client.isReadyToCall(); }, 5000);
+    for (int i = 0; i < calls; i++)
+    {
+        // trigger at a random point, the receive window of "before" runs on its own
+        auto idle_until = millis() + random.up_to(RECEIVE_WINDOW_MS);
+        run_until([&] { return millis() >= idle_until; }, RECEIVE_WINDOW_MS + 1);
+        if (!run_until([&] { return client.isReadyToCall(); }, 5000))
+            break;
+        server.forget_calls();
+        cancelled = false;
+        auto trigger = Clock::now();
+        client.request_ring("**610", "Door");
+        bool authorized = run_until([&] { return server.last_call() != nullptr && server.last_call()->authorized_invite_at != 0; }, 5000);
+        auto arrived = Clock::now();
+        if (authorized)
+            latencies.samples.push_back(std::chrono::duration<double, std::milli>(arrived - trigger).count());
+        client.request_cancel();
+        run_until([&] { return cancelled; }, 5000);
+    }
+    client.stop();
+    return latencies;
+}
+
+template <class SocketT>
+void report(bench::Runner& runner, const char* name, int calls)
+{
+    Latencies latencies = measure_calls<SocketT>(calls);
+    auto& result = runner.record("latency", name);
+    result.metrics.push_back({ "calls", (double) latencies.samples.size() });
+    result.metrics.push_back({ "p50_ms", latencies.percentile(0.5) });
+    result.metrics.push_back({ "p90_ms", latencies.percentile(0.9) });
+    result.metrics.push_back({ "max_ms", latencies.percentile(1.0) });
+}
+
+} // namespace
+
+BENCHMARK("latency", trigger_to_invite)
+{
+    int calls = runner.quick() ? 3 : 25;
+    report<AccumulatingUdpClient>(runner, "trigger->auth INVITE, before", calls);
+    report<PosixUdpClient>(runner, "trigger->auth INVITE, after", calls);
+}
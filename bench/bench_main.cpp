@@ -0,0 +1,100 @@
+/**
+ * sip_bench [--quick] [--json FILE] [GROUP...]
+ *
+ * Runs the registered benchmarks, or only those of the given groups, prints a table
+ * and writes the results as JSON. --quick runs every benchmark briefly, as ctest does.
+ */
+#include "bench.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace bench {
+HeapCounters heap;
+}
+
+void* operator new(size_t size)
+{
+    bench::heap.allocations++;
+    bench::heap.bytes += size;
+    void* pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+static void write_json(FILE* file, const std::vector<bench::Result>& results)
+{
+    fprintf(file, "{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        auto& result = results[i];
+        fprintf(file, "    {\"group\": \"%s\", \"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f, \"allocations_per_op\": %.4f, \"bytes_per_op\": %.2f",
+                result.group.c_str(), result.name.c_str(), (unsigned long long) result.iterations, result.ns_per_op, result.allocations_per_op, result.bytes_per_op);
+        for (auto& metric : result.metrics)
+            fprintf(file, ", \"%s\": %.3f", metric.first.c_str(), metric.second);
+        fprintf(file, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+static void print_table(const std::vector<bench::Result>& results)
+{
+    printf("%-10s %-36s %12s %10s %10s\n", "group", "benchmark", "ns/op", "allocs/op", "bytes/op");
+    for (auto& result : results)
+    {
+        if (result.iterations != 0)
+            printf("%-10s %-36s %12.1f %10.2f %10.1f", result.group.c_str(), result.name.c_str(), result.ns_per_op, result.allocations_per_op, result.bytes_per_op);
+        else
+            printf("%-10s %-36s %12s %10s %10s", result.group.c_str(), result.name.c_str(), "-", "-", "-");
+        for (auto& metric : result.metrics)
+            printf("  %s=%.1f", metric.first.c_str(), metric.second);
+        printf("\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool quick = false;
+    const char* json_path = "sip_bench.json";
+    std::vector<std::string> groups;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--quick") == 0)
+            quick = true;
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            json_path = argv[++i];
+        else
+            groups.push_back(argv[i]);
+    }
+
+    bench::Runner runner(quick);
+    for (auto& benchmark : bench::registry())
+    {
+        if (groups.empty() || std::find(groups.begin(), groups.end(), benchmark.group) != groups.end())
+            benchmark.function(runner);
+    }
+    print_table(runner.results());
+
+    FILE* file = fopen(json_path, "w");
+    if (file == nullptr)
+    {
+        printf("Failed to write %s\n", json_path);
+        return 1;
+    }
+    write_json(file, runner.results());
+    fclose(file);
+    printf("Results written to %s\n", json_path);
+    return 0;
+}
@@ -0,0 +1,56 @@
+/**
+ * Cost per received packet, the string_view SipPacket against the copying one of the baseline
+ *
+ * Both handle a message the way their client did: the baseline copied the datagram into
+ * a std::string, parsed it in place and read the header fields as std::string, the
+ * current client parses the receive slot and reads string_views into it.
+ */
+#include "sip_client/sip_packet.h"
+
+#include "bench.h"
+#include "fritzbox_corpus.h"
+#include "legacy_sip_packet.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+BENCHMARK("packet", packet_per_message)
+{
+    for (auto& entry : fritzbox_corpus::ALL)
+    {
+        // both parsers must agree, otherwise the comparison is meaningless
+        std::string copy(entry.message);
+        LegacySipPacket legacy(copy.c_str(), copy.size());
+        SipPacket current(entry.message.data(), entry.message.size());
+        if (!legacy.parse() || !current.parse() || legacy.get_call_id() != current.get_call_id() || legacy.get_via() != current.get_via())
+        {
+            printf("LegacySipPacket and SipPacket disagree on %s\n", entry.name);
+            exit(1);
+        }
+
+        std::string legacy_name = std::string("LegacySipPacket ") + entry.name;
+        auto& before = runner.measure("packet", legacy_name.c_str(), [&] {
+            std::string received(entry.message);
+            LegacySipPacket packet(received.c_str(), received.size());
+            bool parsed = packet.parse();
+            bench::keep(parsed);
+            std::string to = packet.get_to();
+            std::string from = packet.get_from();
+            std::string via = packet.get_via();
+            std::string cseq = packet.get_cseq();
+            std::string call_id = packet.get_call_id();
+            bench::keep(to.size() + from.size() + via.size() + cseq.size() + call_id.size());
+        });
+        double before_ns = before.ns_per_op;
+
+        std::string name = std::string("SipPacket ") + entry.name;
+        auto& after = runner.measure("packet", name.c_str(), [&] {
+            SipPacket packet(entry.message.data(), entry.message.size());
+            bool parsed = packet.parse();
+            bench::keep(parsed);
+            bench::keep(packet.get_to().size() + packet.get_from().size() + packet.get_via().size() + packet.get_cseq().size() + packet.get_call_id().size());
+        });
+        after.metrics.push_back({ "speedup", before_ns / after.ns_per_op });
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <string_view>
+
+/**
+ * Messages a FRITZ!Box sends to a registered door station, as seen on the wire
+ */
+namespace fritzbox_corpus {
+
+static constexpr std::string_view UNAUTHORIZED_401 =
+    "SIP/2.0 401 Unauthorized\r\n"
+    "Via: SIP/2.0/UDP 192.168.178.50:5060;branch=z9hG4bK1804289383;rport=5060\r\n"
+    "From: <sip:620@192.168.178.1>;tag=846930886\r\n"
+    "To: <sip:620@192.168.178.1>;tag=8F4D9A1B2C3D4E5F\r\n"
+    "Call-ID: 1681692777@192.168.178.50\r\n"
+    "CSeq: 1 REGISTER\r\n"
+    "WWW-Authenticate: Digest realm=\"fritz.box\", nonce=\"7C9E2A41B3D5F687\", algorithm=MD5, qop=\"auth\"\r\n"
+    "User-Agent: FRITZ!OS\r\n"
+    "Content-Length: 0\r\n"
+    "\r\n";
+
+static constexpr std::string_view TRYING_100 =
+    "SIP/2.0 100 Trying\r\n"
+    "Via: SIP/2.0/UDP 192.168.178.50:5060;branch=z9hG4bK1714636915;rport=5060\r\n"
+    "From: \"Door\" <sip:620@192.168.178.1>;tag=1957747793\r\n"
+    "To: <sip:**610@192.168.178.1>\r\n"
+    "Call-ID: 424238335@192.168.178.50\r\n"
+    "CSeq: 2 INVITE\r\n"
+    "User-Agent: FRITZ!OS\r\n"
+    "Content-Length: 0\r\n"
+    "\r\n";
+
+static constexpr std::string_view SESSION_PROGRESS_183 =
+    "SIP/2.0 183 Session Progress\r\n"
+    "Via: SIP/2.0/UDP 192.168.178.50:5060;branch=z9hG4bK1714636915;rport=5060\r\n"
+    "From: \"Door\" <sip:620@192.168.178.1>;tag=1957747793\r\n"
+    "To: <sip:**610@192.168.178.1>;tag=A3C8E0F1B2D49786\r\n"
+    "Call-ID: 424238335@192.168.178.50\r\n"
+    "CSeq: 2 INVITE\r\n"
+    "Contact: <sip:**610@192.168.178.1:5060>\r\n"
+    "User-Agent: FRITZ!OS\r\n"
+    "Content-Type: application/sdp\r\n"
+    "Content-Length: 216\r\n"
+    "\r\n"
+    "v=0\r\n"
+    "o=user 3261 3261 IN IP4 192.168.178.1\r\n"
+    "s=call\r\n"
+    "c=IN IP4 192.168.178.1\r\n"
+    "t=0 0\r\n"
+    "m=audio 7078 RTP/AVP 8 0 101\r\n"
+    "a=rtpmap:8 PCMA/8000\r\n"
+    "a=rtpmap:0 PCMU/8000\r\n"
+    "a=rtpmap:101 telephone-event/8000\r\n"
+    "a=sendrecv\r\n"
+    "a=ptime:20\r\n";
+
+static constexpr std::string_view OK_200_INVITE =
+    "SIP/2.0 200 OK\r\n"
+    "Via: SIP/2.0/UDP 192.168.178.50:5060;branch=z9hG4bK1714636915;rport=5060\r\n"
+    "From: \"Door\" <sip:620@192.168.178.1>;tag=1957747793\r\n"
+    "To: <sip:**610@192.168.178.1>;tag=A3C8E0F1B2D49786\r\n"
+    "Call-ID: 424238335@192.168.178.50\r\n"
+    "CSeq: 2 INVITE\r\n"
+    "Contact: <sip:**610@192.168.178.1:5060>\r\n"
+    "Allow: INVITE, ACK, OPTIONS, CANCEL, BYE, UPDATE, PRACK, INFO, SUBSCRIBE, NOTIFY, REFER, MESSAGE, PUBLISH\r\n"
+    "Supported: replaces, timer\r\n"
+    "User-Agent: FRITZ!OS\r\n"
+    "Content-Type: application/sdp\r\n"
+    "Content-Length: 216\r\n"
+    "\r\n"
+    "v=0\r\n"
+    "o=user 3261 3262 IN IP4 192.168.178.1\r\n"
+    "s=call\r\n"
+    "c=IN IP4 192.168.178.1\r\n"
+    "t=0 0\r\n"
+    "m=audio 7078 RTP/AVP 8 0 101\r\n"
+    "a=rtpmap:8 PCMA/8000\r\n"
+    "a=rtpmap:0 PCMU/8000\r\n"
+    "a=rtpmap:101 telephone-event/8000\r\n"
+    "a=sendrecv\r\n"
+    "a=ptime:20\r\n";
+
+static constexpr std::string_view NOTIFY =
+    "NOTIFY sip:620@192.168.178.50:5060 SIP/2.0\r\n"
+    "Via: SIP/2.0/UDP 192.168.178.1:5060;branch=z9hG4bK6B8B4567\r\n"
+    "From: <sip:620@192.168.178.1>;tag=327B23C6\r\n"
+    "To: <sip:620@192.168.178.1>\r\n"
+    "Call-ID: 643C9869@192.168.178.1\r\n"
+    "CSeq: 1 NOTIFY\r\n"
+    "Contact: <sip:620@192.168.178.1>\r\n"
+    "Event: message-summary\r\n"
+    "Subscription-State: active\r\n"
+    "Max-Forwards: 70\r\n"
+    "User-Agent: FRITZ!OS\r\n"
+    "Content-Type: application/simple-message-summary\r\n"
+    "Content-Length: 22\r\n"
+    "\r\n"
+    "Messages-Waiting: no\r\n";
+
+static constexpr std::string_view INFO_DTMF =
+    "INFO sip:620@192.168.178.50:5060 SIP/2.0\r\n"
+    "Via: SIP/2.0/UDP 192.168.178.1:5060;branch=z9hG4bK66334873\r\n"
+    "From: <sip:**610@192.168.178.1>;tag=A3C8E0F1B2D49786\r\n"
+    "To: \"Door\" <sip:620@192.168.178.1>;tag=1957747793\r\n"
+    "Call-ID: 424238335@192.168.178.50\r\n"
+    "CSeq: 3 INFO\r\n"
+    "Contact: <sip:**610@192.168.178.1:5060>\r\n"
+    "Max-Forwards: 70\r\n"
+    "User-Agent: FRITZ!OS\r\n"
+    "Content-Type: application/dtmf-relay\r\n"
+    "Content-Length: 24\r\n"
+    "\r\n"
+    "Signal=5\r\n"
+    "Duration=160\r\n";
+
+struct Entry
+{
+    const char* name;
+    std::string_view message;
+};
+
+static constexpr Entry ALL[] = {
+    { "401", UNAUTHORIZED_401 },
+    { "100", TRYING_100 },
+    { "183", SESSION_PROGRESS_183 },
+    { "200", OK_200_INVITE },
+    { "NOTIFY", NOTIFY },
+    { "INFO-dtmf", INFO_DTMF },
+};
+
+} // namespace fritzbox_corpus
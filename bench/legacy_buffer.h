@@ -0,0 +1,80 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/**
+ * Buffer as it was before it tracked its length, kept to benchmark against:
+ * every append scans the content with strlen, numbers go through snprintf
+ */
+template<std::size_t SIZE>
+class LegacyBuffer
+{
+public:
+    LegacyBuffer()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        m_buffer[0] = '\0';
+    }
+
+    LegacyBuffer<SIZE>& operator<<(const char* str)
+    {
+        strncat(m_buffer.data(), str, m_buffer.size() - strlen(m_buffer.data()) - 1);
+        return *this;
+    }
+    LegacyBuffer<SIZE>& operator<<(const std::string& str)
+    {
+        strncat(m_buffer.data(), str.c_str(), m_buffer.size() - strlen(m_buffer.data()) - 1);
+        return *this;
+    }
+    LegacyBuffer<SIZE>& operator<<(std::string_view str)
+    {
+        size_t length = strlen(m_buffer.data());
+        size_t count = std::min(str.size(), m_buffer.size() - length - 1);
+        memcpy(m_buffer.data() + length, str.data(), count);
+        m_buffer[length + count] = '\0';
+        return *this;
+    }
+    LegacyBuffer<SIZE>& operator<<(int8_t i)
+    {
+        snprintf(m_buffer.data() + strlen(m_buffer.data()), m_buffer.size() - strlen(m_buffer.data()), "%c", i);
+        return *this;
+    }
+    LegacyBuffer<SIZE>& operator<<(uint8_t i)
+    {
+        snprintf(m_buffer.data() + strlen(m_buffer.data()), m_buffer.size() - strlen(m_buffer.data()), "%c", i);
+        return *this;
+    }
+    LegacyBuffer<SIZE>& operator<<(uint16_t i)
+    {
+        snprintf(m_buffer.data() + strlen(m_buffer.data()), m_buffer.size() - strlen(m_buffer.data()), "%d", i);
+        return *this;
+    }
+    LegacyBuffer<SIZE>& operator<<(uint32_t i)
+    {
+        snprintf(m_buffer.data() + strlen(m_buffer.data()), m_buffer.size() - strlen(m_buffer.data()), "%d", i);
+        return *this;
+    }
+
+    const char* data() const
+    {
+        return m_buffer.data();
+    }
+
+    size_t size() const
+    {
+        return strlen(m_buffer.data());
+    }
+
+private:
+    std::array<char, SIZE> m_buffer;
+};
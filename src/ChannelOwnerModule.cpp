@@ -210,13 +210,14 @@ void SIPChannelOwnerModule::processInputKo(GroupObject &ko)
     OpenKNX::Module::processInputKo(ko);
     if (_pChannels != nullptr)
     {
-        for (uint8_t _channelIndex = 0; _channelIndex < _numberOfChannels; _channelIndex++)
+        // only the channel owning the KO gets the telegram, KOs outside of the channel blocks go to no channel
+        int16_t _channelIndex = SIP_KoCalcChannel(ko.asap());
+        if (_channelIndex < 0 || _channelIndex >= _numberOfChannels)
+            return;
+        OpenKNX::Channel* channel = _pChannels[_channelIndex];
+        if (channel != nullptr)
         {
-            OpenKNX::Channel* channel = _pChannels[_channelIndex];
-            if (channel != nullptr)
-            {
-                channel->processInputKo(ko);
-            }
+            channel->processInputKo(ko);
         }
     }
 }
@@ -1,4 +1,5 @@
 #include "SIPCallNumberChannel.h"
+#include "SIPModule.h"
 
 SIPCallNumberChannel::SIPCallNumberChannel(uint8_t channelIndex)
 {
@@ -12,17 +13,20 @@ const std::string SIPCallNumberChannel::name()
     return _name;
 }
 
-bool SIPCallNumberChannel::needCall()
+const char *SIPCallNumberChannel::getPhoneNumber()
 {
-    auto result = _triggered;
-    if (result)
-        _triggered = false;
-    return result;
+    return (const char *)ParamSIP_CHPhoneNumber;
 }
 
-const char *SIPCallNumberChannel::getPhoneNumber()
+void SIPCallNumberChannel::prepareCall(const std::string& serverIP)
 {
-    return (const char *)ParamSIP_CHPhoneNumber;
+    // parameters only change with a restart, the server with a new SIP client
+    _callTarget.prepare(getPhoneNumber(), serverIP);
+}
+
+const SipCallTarget& SIPCallNumberChannel::getCallTarget()
+{
+    return _callTarget;
 }
 
 uint8_t SIPCallNumberChannel::getCancelCallTime()
@@ -38,7 +42,7 @@ void SIPCallNumberChannel::processInputKo(GroupObject &ko)
     {
         case SIP_KoCHPhoneNumber:
             if (ko.value(DPT_Trigger))
-                _triggered = true;
+                openknxSIPModule.queueCall(_channelIndex);
             break;
     }
 }
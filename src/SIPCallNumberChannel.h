@@ -1,15 +1,17 @@
 #pragma once
 #include "OpenKNX.h"
+#include "sip_client/sip_call_target.h"
 
 class SIPCallNumberChannel : public OpenKNX::Channel
 {
-        volatile bool _triggered = false;
         std::string _name = std::string();
+        SipCallTarget _callTarget;
     public:
         SIPCallNumberChannel(uint8_t channelIndex);
         const std::string name() override;
-        bool needCall();  
         const char* getPhoneNumber();
+        void prepareCall(const std::string& serverIP);
+        const SipCallTarget& getCallTarget();
         uint8_t getCancelCallTime();
         void processInputKo(GroupObject &ko) override;
         bool processCommand(const std::string cmd, bool diagnoseKo);
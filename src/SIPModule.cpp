@@ -10,12 +10,16 @@
 #include "sip_client/wifi_udp_client.h"
 #include "sip_client/mbedtls_md5.h"
 #include "sip_client/sip_client.h"
+#include <new>
 
 using SipClientT = SipClient<WifiUdpClient, MbedtlsMd5>;
 
+// the client is constructed once on the first connection and reset in place on a network loss
+alignas(SipClientT) static uint8_t sipClientStorage[sizeof(SipClientT)];
+
 
 SIPModule::SIPModule()
- : SIPChannelOwnerModule(SIP_ChannelCount)
+ : SIPChannelOwnerModule(SIP_ChannelCount), _callQueue(SIP_CALL_COALESCE_MS)
 {
 
 }
@@ -43,10 +47,10 @@ void SIPModule::showInformations()
         return;
     }
     auto sipClient = (SipClientT*)_sipClient;
-    if (sipClient != nullptr)
+    if (_sipClientStarted)
     {
         if (sipClient->isConnected())
-            openknx.logger.logWithPrefix("SIP", "connected");
+            openknx.logger.logWithPrefix("SIP", "connected, %d active calls", (int) sipClient->get_active_calls());
         else
             openknx.logger.logWithPrefix("SIP", "not connected");
     }
@@ -54,6 +58,8 @@ void SIPModule::showInformations()
     {
         openknx.logger.logWithPrefix("SIP", "not started");
     }
+    openknx.logger.logWithPrefix("SIP", "calls queued %u, coalesced %u, dropped %u, waiting %d",
+        (unsigned) _callQueue.queued(), (unsigned) _callQueue.coalesced(), (unsigned) _callQueue.dropped(), (int) _callQueue.waiting());
 }
 
 void SIPModule::showHelp()
@@ -61,7 +67,7 @@ void SIPModule::showHelp()
     if (ParamSIP_SIPNumChannels == 0)
         return;
     openknx.console.printHelpLine("sip<CC> call", "Call the number which is configured in channel CC. i.e. sip1 call");
-    openknx.console.printHelpLine("sip hangup", "Hangup the current call.");
+    openknx.console.printHelpLine("sip hangup", "Hangup all current calls.");
 }
 
 
@@ -72,7 +78,7 @@ bool SIPModule::processCommand(const std::string cmd, bool diagnoseKo)
     if (cmd == "sip hangup")
     {
         auto sipClient = (SipClientT*)_sipClient;
-        if (sipClient != nullptr)
+        if (_sipClientStarted)
             sipClient->request_cancel();
         return true;
     }
@@ -116,6 +122,22 @@ bool SIPModule::processCommand(const std::string cmd, bool diagnoseKo)
 }
 
 
+/**
+ * Called by a channel on a trigger, the call is started by the next loop()
+ */
+void SIPModule::queueCall(uint8_t channelIndex)
+{
+    auto channel = (SIPCallNumberChannel*) getChannel(channelIndex);
+    if (channel == nullptr)
+        return;
+    auto sipClient = (SipClientT*)_sipClient;
+    auto result = _callQueue.push(channelIndex, millis(), [&](int call) { return _sipClientStarted && sipClient->isCallActive(call); });
+    if (result == SIPCallQueueT::Push::COALESCED)
+        logDebugP("Call of channel %d coalesced", channelIndex + 1);
+    else if (result == SIPCallQueueT::Push::DROPPED)
+        logErrorP("Call queue full, call of channel %d dropped", channelIndex + 1);
+}
+
 OpenKNX::Channel* SIPModule::createChannel(uint8_t _channelIndex /* this parameter is used in macros, do not rename */)
 {
     if (_channelIndex >= ParamSIP_SIPNumChannels)
@@ -136,7 +158,7 @@ void SIPModule::loop()
     if (ParamSIP_SIPNumChannels == 0)
         return;
     auto sipClient = (SipClientT*)_sipClient;
-    if (sipClient != nullptr)
+    if (_sipClientStarted)
     {
         bool connected = sipClient->isConnected();
 #ifdef WLAN_WifiSSID
@@ -145,47 +167,29 @@ void SIPModule::loop()
         if (!openknxNetwork.established())
 #endif            
         {
-            delete sipClient;
-            _sipClient = nullptr;
+            // keeps the buffers and the digest challenge for the next connection
+            sipClient->stop();
+            _sipClientStarted = false;
             _connected = false;
-            _sipCallSince = 0;
         }
         if (_connected != connected)
         {
             _connected = connected;
             KoSIP_GatewayConnectionState.value(_connected, DPT_Switch);
         }
-        if (_sipClient == nullptr)
+        if (!_sipClientStarted)
             return;
         sipClient->run();
 
-        if (_sipCallSince > 0)
+        // start queued calls in trigger order as long as the client has a free dialog
+        while (!_callQueue.empty() && sipClient->isReadyToCall())
         {
-            // SIP call active
-            auto now = millis();
-            if (now - _sipCallSince > _sipCallTimeoutMs)
-            {
-                _sipCallSince = 0;
-                logDebugP("Cancel call");
-                sipClient->request_cancel();
-            }
-        }
-        else
-        {          
-            auto channel = (SIPCallNumberChannel*) getChannel(_currentChannel);
-            _currentChannel++;
-            if (_currentChannel >= getNumberOfChannels())
-                _currentChannel = 0;
-            if (channel != nullptr && channel->needCall())
-            {
-                _sipCallSince = millis();
-                if (_sipCallSince == 0)
-                    _sipCallSince++;
-                _sipCallTimeoutMs = channel->getCancelCallTime() * 1000;
-                std::string phoneNumber = channel->getPhoneNumber();
-                logDebugP("Call phone number %s", phoneNumber.c_str());
-                sipClient->request_ring(phoneNumber, "555");
-            }
+            auto channelIndex = _callQueue.pop();
+            auto channel = (SIPCallNumberChannel*) getChannel(channelIndex);
+            logDebugP("Call phone number %s", channel->getPhoneNumber());
+            // the client cancels the call after the configured time, until then triggers are merged into it
+            auto call = sipClient->request_ring(channel->getCallTarget(), "555", channel->getCancelCallTime() * 1000);
+            _callQueue.started(channelIndex, call);
         }
     }
 #ifdef WLAN_WifiSSID
@@ -203,9 +207,6 @@ void SIPModule::loop()
         auto localIP = openknxNetwork.localIP();
 #endif  
 
-        auto user = std::string((const char*)ParamSIP_SIPUser);
-        auto password = std::string((const char*)ParamSIP_SIPPassword);
-
         std::string serverIP;
         if (ParamSIP_UseIPGateway)
         {
@@ -217,18 +218,37 @@ void SIPModule::loop()
             uint32_t arduinoIP = ((parameterIP & 0xFF000000) >> 24) | ((parameterIP & 0x00FF0000) >> 8) | ((parameterIP & 0x0000FF00) << 8) | ((parameterIP & 0x000000FF) << 24);
             serverIP = IPAddress(arduinoIP).toString().c_str();
         }
-        uint16_t serverPort = ParamSIP_SIPGatewayPort;
-        char buffer[10] = {0};
-        std::string serverPortStr = itoa(serverPort, buffer, 10);
         auto localIPStr = std::string(localIP.toString().c_str());
- 
-        logDebugP("User: %s", user.c_str());
+
         logDebugP("Server IP: %s", serverIP.c_str());
-        logDebugP("Port: %s", serverPortStr.c_str());
-        logDebugP("Local IP: %s", localIP.toString().c_str());
-        auto sipClient = new SipClientT(user, password, serverIP, serverPortStr, localIPStr);
-        _sipClient = sipClient;
+        logDebugP("Local IP: %s", localIPStr.c_str());
+        if (sipClient == nullptr)
+        {
+            auto user = std::string((const char*)ParamSIP_SIPUser);
+            auto password = std::string((const char*)ParamSIP_SIPPassword);
+            uint16_t serverPort = ParamSIP_SIPGatewayPort;
+            char buffer[10] = {0};
+            std::string serverPortStr = itoa(serverPort, buffer, 10);
+
+            logDebugP("User: %s", user.c_str());
+            logDebugP("Port: %s", serverPortStr.c_str());
+            sipClient = new (sipClientStorage) SipClientT(user, password, serverIP, serverPortStr, localIPStr);
+            _sipClient = sipClient;
+        }
+        else
+        {
+            // addresses may have changed while the network was gone
+            sipClient->set_server_ip(serverIP);
+            sipClient->set_my_ip(localIPStr);
+        }
+        for (uint8_t i = 0; i < getNumberOfChannels(); i++)
+        {
+            auto channel = (SIPCallNumberChannel*) getChannel(i);
+            if (channel != nullptr)
+                channel->prepareCall(serverIP);
+        }
         bool initialized = sipClient->init();
+        _sipClientStarted = true;
         logDebugP("SIP Client inialized: %d", (int) initialized);
     }
     SIPChannelOwnerModule::loop();
@@ -1,14 +1,27 @@
 #pragma once
 #include "OpenKNX.h"
 #include "ChannelOwnerModule.h"
+#include "sip_client/sip_call_queue.h"
+
+// number of distinct channels that can wait for a free call
+#ifndef SIP_CALL_QUEUE_SIZE
+#define SIP_CALL_QUEUE_SIZE 8
+#endif
+
+// triggers of a channel within this time after its last call request are merged into it,
+// as are all triggers while its call is set up or rings
+#ifndef SIP_CALL_COALESCE_MS
+#define SIP_CALL_COALESCE_MS 2000
+#endif
+
+using SIPCallQueueT = SipCallQueue<SIP_CALL_QUEUE_SIZE, SIP_ChannelCount>;
 
 class SIPModule : public SIPChannelOwnerModule
 {
    void* _sipClient = nullptr;
-   unsigned long _sipCallTimeoutMs = 0;
-   unsigned long _sipCallSince = 0;
-   uint8_t _currentChannel = 0;
+   bool _sipClientStarted = false;
    bool _connected;
+   SIPCallQueueT _callQueue;
   protected:
     OpenKNX::Channel* createChannel(uint8_t _channelIndex /* this parameter is used in macros, do not rename */) override; 
 
@@ -23,6 +36,7 @@ class SIPModule : public SIPChannelOwnerModule
     void showHelp() override;
     bool connected();
     bool processCommand(const std::string cmd, bool diagnoseKo) override;
+    void queueCall(uint8_t channelIndex);
 };
 
 extern SIPModule openknxSIPModule;
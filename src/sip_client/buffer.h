@@ -0,0 +1,132 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+static constexpr const int TX_BUFFER_SIZE = 2048;
+
+/**
+ * Message writer with a fixed capacity
+ *
+ * The length is tracked, so every append is O(1) and the content stays null terminated.
+ * Content that does not fit is cut off and marks the buffer as overflowed,
+ * the message must not be sent in that case.
+ */
+template<std::size_t SIZE>
+class Buffer
+{
+public:
+    Buffer()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        m_length = 0;
+        m_overflow = false;
+        m_buffer[0] = '\0';
+    }
+
+    Buffer<SIZE>& operator<<(const char* str)
+    {
+        append(str, strlen(str));
+        return *this;
+    }
+    Buffer<SIZE>& operator<<(const std::string& str)
+    {
+        append(str.data(), str.size());
+        return *this;
+    }
+    Buffer<SIZE>& operator<<(std::string_view str)
+    {
+        append(str.data(), str.size());
+        return *this;
+    }
+    template<std::size_t OTHER_SIZE>
+    Buffer<SIZE>& operator<<(const Buffer<OTHER_SIZE>& other)
+    {
+        append(other.data(), other.size());
+        return *this;
+    }
+    Buffer<SIZE>& operator<<(int8_t i)
+    {
+        char c = i;
+        append(&c, 1);
+        return *this;
+    }
+    Buffer<SIZE>& operator<<(uint8_t i)
+    {
+        char c = i;
+        append(&c, 1);
+        return *this;
+    }
+    Buffer<SIZE>& operator<<(uint16_t i)
+    {
+        append_number(i);
+        return *this;
+    }
+    Buffer<SIZE>& operator<<(uint32_t i)
+    {
+        append_number(i);
+        return *this;
+    }
+
+    const char* data() const
+    {
+        return m_buffer.data();
+    }
+
+    size_t size() const
+    {
+        return m_length;
+    }
+
+    std::string_view view() const
+    {
+        return std::string_view(m_buffer.data(), m_length);
+    }
+
+    /**
+     * Something was cut off since the last clear()
+     */
+    bool overflowed() const
+    {
+        return m_overflow;
+    }
+
+private:
+    void append(const char* str, size_t length)
+    {
+        size_t available = SIZE - 1 - m_length;
+        if (length > available)
+        {
+            length = available;
+            m_overflow = true;
+        }
+        memcpy(m_buffer.data() + m_length, str, length);
+        m_length += length;
+        m_buffer[m_length] = '\0';
+    }
+
+    void append_number(uint32_t value)
+    {
+        char digits[10];
+        size_t pos = sizeof(digits);
+        do
+        {
+            digits[--pos] = '0' + value % 10;
+            value /= 10;
+        } while (value != 0);
+        append(digits + pos, sizeof(digits) - pos);
+    }
+
+    std::array<char, SIZE> m_buffer;
+    size_t m_length;
+    bool m_overflow;
+};
+
+using TxBufferT = Buffer<TX_BUFFER_SIZE>;
@@ -0,0 +1,259 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#ifdef ARDUINO_ARCH_ESP32
+#include "freertos/FreeRTOS.h"
+#endif
+
+/**
+ * Bounded queue of received datagrams in fixed slots
+ *
+ * One producer (network task or socket poll) and one consumer (loop) are supported.
+ * The producer reserves a slot, fills it outside of the lock and commits it.
+ * The consumer claims one datagram at a time, it stays valid until the next receive() or release().
+ * If no slot is free, either the new datagram or the oldest unread one is dropped,
+ * a claimed or reserved slot is never overwritten. With a handful of slots a linear
+ * search is cheaper than keeping the order in a linked structure.
+ */
+template <size_t SLOTS, size_t SLOT_SIZE>
+class DatagramRing
+{
+public:
+    enum class Policy {
+        DROP_NEWEST,
+        DROP_OLDEST,
+    };
+
+    struct Slot
+    {
+        size_t length;
+        uint32_t remote_ip;
+        uint16_t remote_port;
+        unsigned long received_at;
+        std::array<char, SLOT_SIZE> data;
+
+        std::string_view view() const
+        {
+            return std::string_view(data.data(), length);
+        }
+    };
+
+    explicit DatagramRing(Policy policy = Policy::DROP_OLDEST)
+    : m_policy(policy)
+    {
+    }
+
+    /**
+     * Producer: get a free slot for a datagram of the given length,
+     * nullptr if the datagram is dropped. Must be followed by commit().
+     */
+    Slot* reserve(size_t length)
+    {
+        if (length > SLOT_SIZE)
+        {
+            m_dropped_oversize++;
+            return nullptr;
+        }
+        lock();
+        int index = find(State::FREE);
+        if (index < 0 && m_policy == Policy::DROP_OLDEST)
+        {
+            index = find(State::READY);
+            if (index >= 0)
+            {
+                m_pending--;
+                m_dropped_oldest++;
+            }
+        }
+        if (index < 0)
+        {
+            m_dropped_newest++;
+            unlock();
+            return nullptr;
+        }
+        m_state[index] = State::RESERVED;
+        m_reserved = index;
+        unlock();
+        m_slots[index].length = length;
+        return &m_slots[index];
+    }
+
+    /**
+     * Producer: the reserved slot is filled and can be read
+     */
+    void commit()
+    {
+        lock();
+        m_state[m_reserved] = State::READY;
+        m_sequence[m_reserved] = m_next_sequence++;
+        m_pending++;
+        m_received++;
+        unlock();
+    }
+
+    Slot* push(const char* data, size_t length, uint32_t remote_ip, uint16_t remote_port, unsigned long now)
+    {
+        Slot* slot = reserve(length);
+        if (slot == nullptr)
+        {
+            return nullptr;
+        }
+        memcpy(slot->data.data(), data, length);
+        slot->remote_ip = remote_ip;
+        slot->remote_port = remote_port;
+        slot->received_at = now;
+        commit();
+        return slot;
+    }
+
+    /**
+     * Producer: a datagram can be reserved without dropping a queued one
+     */
+    bool has_free_slot()
+    {
+        lock();
+        bool result = find(State::FREE) >= 0;
+        unlock();
+        return result;
+    }
+
+    bool has_pending() const
+    {
+        return m_pending > 0;
+    }
+
+    /**
+     * Consumer: release the last datagram and claim the next one, nullptr if none is waiting
+     */
+    const Slot* receive()
+    {
+        lock();
+        release_claimed();
+        int index = find(State::READY);
+        if (index >= 0)
+        {
+            m_state[index] = State::CLAIMED;
+            m_pending--;
+        }
+        unlock();
+        return index < 0 ? nullptr : &m_slots[index];
+    }
+
+    /**
+     * Consumer: the claimed datagram is not used anymore
+     */
+    void release()
+    {
+        lock();
+        release_claimed();
+        unlock();
+    }
+
+    uint32_t get_received() const
+    {
+        return m_received;
+    }
+
+    uint32_t get_dropped_oldest() const
+    {
+        return m_dropped_oldest;
+    }
+
+    uint32_t get_dropped_newest() const
+    {
+        return m_dropped_newest;
+    }
+
+    uint32_t get_dropped_oversize() const
+    {
+        return m_dropped_oversize;
+    }
+
+    uint32_t get_dropped() const
+    {
+        return m_dropped_oldest + m_dropped_newest + m_dropped_oversize;
+    }
+
+private:
+    enum class State : uint8_t {
+        FREE,
+        RESERVED,
+        READY,
+        CLAIMED,
+    };
+
+    /**
+     * First free slot or oldest slot in the given state, -1 if there is none
+     */
+    int find(State state) const
+    {
+        int found = -1;
+        for (size_t i = 0; i < SLOTS; i++)
+        {
+            if (m_state[i] != state)
+                continue;
+            if (state == State::FREE)
+                return i;
+            if (found < 0 || (int32_t) (m_sequence[i] - m_sequence[found]) < 0)
+                found = i;
+        }
+        return found;
+    }
+
+    void release_claimed()
+    {
+        for (size_t i = 0; i < SLOTS; i++)
+        {
+            if (m_state[i] == State::CLAIMED)
+                m_state[i] = State::FREE;
+        }
+    }
+
+    void lock()
+    {
+#ifdef ARDUINO_ARCH_ESP32
+        portENTER_CRITICAL(&m_mux);
+#endif
+    }
+
+    void unlock()
+    {
+#ifdef ARDUINO_ARCH_ESP32
+        portEXIT_CRITICAL(&m_mux);
+#endif
+    }
+
+    const Policy m_policy;
+    std::array<Slot, SLOTS> m_slots;
+    // the order of the slots is given by the sequence number of the commit
+    std::array<State, SLOTS> m_state = {};
+    std::array<uint32_t, SLOTS> m_sequence = {};
+    uint32_t m_next_sequence = 0;
+    size_t m_reserved = 0;
+    volatile size_t m_pending = 0;
+
+    volatile uint32_t m_received = 0;
+    volatile uint32_t m_dropped_oldest = 0;
+    volatile uint32_t m_dropped_newest = 0;
+    volatile uint32_t m_dropped_oversize = 0;
+
+#ifdef ARDUINO_ARCH_ESP32
+    portMUX_TYPE m_mux = portMUX_INITIALIZER_UNLOCKED;
+#endif
+};
+
+// received datagrams wait here for the loop, larger datagrams than fit into an ethernet frame are dropped
+static constexpr const size_t RX_QUEUE_SLOTS = 4;
+static constexpr const size_t RX_SLOT_SIZE = 1472;
+
+using RxRingT = DatagramRing<RX_QUEUE_SLOTS, RX_SLOT_SIZE>;
+using RxDatagramT = RxRingT::Slot;
+
+// the RTP socket only keeps the media port open, nothing reads from it yet,
+// a single slot for one G.711 packet of 20 ms is enough
+static constexpr const size_t RTP_QUEUE_SLOTS = 1;
+static constexpr const size_t RTP_SLOT_SIZE = 256;
@@ -0,0 +1,138 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+/**
+ * String with an inline, fixed capacity, it never allocates
+ *
+ * Assigning or appending more than CAPACITY characters cuts the value off and
+ * returns false, the content always stays null terminated.
+ */
+template<std::size_t CAPACITY>
+class FixedString
+{
+public:
+    FixedString()
+    {
+        clear();
+    }
+
+    FixedString(std::string_view str)
+    {
+        assign(str);
+    }
+
+    FixedString& operator=(std::string_view str)
+    {
+        assign(str);
+        return *this;
+    }
+
+    FixedString& operator+=(std::string_view str)
+    {
+        append(str);
+        return *this;
+    }
+
+    bool assign(std::string_view str)
+    {
+        m_length = 0;
+        return append(str);
+    }
+
+    bool append(std::string_view str)
+    {
+        size_t length = str.size();
+        bool fits = length <= CAPACITY - m_length;
+        if (!fits)
+            length = CAPACITY - m_length;
+        // the source may be a part of this string
+        memmove(m_data.data() + m_length, str.data(), length);
+        m_length += length;
+        m_data[m_length] = '\0';
+        return fits;
+    }
+
+    void clear()
+    {
+        m_length = 0;
+        m_data[0] = '\0';
+    }
+
+    const char* c_str() const
+    {
+        return m_data.data();
+    }
+
+    const char* data() const
+    {
+        return m_data.data();
+    }
+
+    size_t size() const
+    {
+        return m_length;
+    }
+
+    bool empty() const
+    {
+        return m_length == 0;
+    }
+
+    static constexpr size_t capacity()
+    {
+        return CAPACITY;
+    }
+
+    std::string_view view() const
+    {
+        return std::string_view(m_data.data(), m_length);
+    }
+
+    operator std::string_view() const
+    {
+        return view();
+    }
+
+    bool operator==(std::string_view other) const
+    {
+        return view() == other;
+    }
+
+    bool operator!=(std::string_view other) const
+    {
+        return view() != other;
+    }
+
+private:
+    std::array<char, CAPACITY + 1> m_data;
+    size_t m_length;
+};
+
+// Capacities of the strings of the SIP stack, the ETS allows 30 characters for
+// user and password and 15 for a phone number
+static constexpr const size_t SIP_USER_SIZE = 32;
+static constexpr const size_t SIP_PASSWORD_SIZE = 32;
+static constexpr const size_t SIP_NUMBER_SIZE = 32;
+static constexpr const size_t SIP_HOST_SIZE = 64;
+// sip:<number or user>@<host>, or the URI of a Contact header
+static constexpr const size_t SIP_URI_SIZE = 128;
+static constexpr const size_t SIP_TAG_SIZE = 64;
+static constexpr const size_t SIP_REALM_SIZE = 64;
+// nonce and opaque are chosen by the server, 128 covers the usual hex and base64 values
+static constexpr const size_t SIP_NONCE_SIZE = 128;
+static constexpr const size_t SIP_DISPLAY_SIZE = 32;
+static constexpr const size_t SIP_PORT_SIZE = 8;
+
+using SipUserT = FixedString<SIP_USER_SIZE>;
+using SipPasswordT = FixedString<SIP_PASSWORD_SIZE>;
+using SipNumberT = FixedString<SIP_NUMBER_SIZE>;
+using SipHostT = FixedString<SIP_HOST_SIZE>;
+using SipUriT = FixedString<SIP_URI_SIZE>;
+using SipTagT = FixedString<SIP_TAG_SIZE>;
+using SipRealmT = FixedString<SIP_REALM_SIZE>;
+using SipNonceT = FixedString<SIP_NONCE_SIZE>;
+using SipDisplayT = FixedString<SIP_DISPLAY_SIZE>;
+using SipPortT = FixedString<SIP_PORT_SIZE>;
@@ -16,6 +16,9 @@
 
 #include "md5_l.h"
 
+#include <cstring>
+#include <string>
+
 
 class MbedtlsMd5
 {
@@ -37,7 +40,17 @@ public:
 
     void update(const std::string& input)
     {
-        mbedtls_l_md5_update(&m_ctx, reinterpret_cast<const unsigned char*>(input.c_str()), input.size());
+        update(input.data(), input.size());
+    }
+
+    void update(const char* input, size_t length)
+    {
+        mbedtls_l_md5_update(&m_ctx, reinterpret_cast<const unsigned char*>(input), length);
+    }
+
+    void update(const char* input)
+    {
+        update(input, strlen(input));
     }
 
     void finish(unsigned char hash[16])
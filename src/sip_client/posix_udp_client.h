@@ -0,0 +1,247 @@
+#pragma once
+#include "sip_platform.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <string_view>
+
+#include "buffer.h"
+#include "datagram_ring.h"
+#include "fixed_string.h"
+
+/**
+ * UDP transport on a POSIX socket with the interface of WifiUdpClientT,
+ * used to run the SIP client natively
+ */
+template <size_t RX_SLOTS = RX_QUEUE_SLOTS, size_t RX_SIZE = RX_SLOT_SIZE>
+class PosixUdpClientT
+{
+public:
+    using RingT = DatagramRing<RX_SLOTS, RX_SIZE>;
+    using DatagramT = typename RingT::Slot;
+    // the same transport with another receive ring
+    template <size_t SLOTS, size_t SIZE>
+    using WithRing = PosixUdpClientT<SLOTS, SIZE>;
+
+    PosixUdpClientT(const std::string& server, const std::string& server_port, uint16_t local_port)
+    : m_server(server)
+    , m_server_port(atoi(server_port.c_str()))
+    , m_local_port(local_port)
+    , m_logPrefix("SIP UDP")
+    {
+    }
+
+    ~PosixUdpClientT()
+    {
+        deinit();
+    }
+
+    const std::string& logPrefix()
+    {
+        return m_logPrefix;
+    }
+
+    void set_server_ip(std::string_view server)
+    {
+        if (is_initialized())
+        {
+            deinit();
+        }
+        m_server = server;
+    }
+
+    void set_server_port(std::string_view server_port)
+    {
+        if (is_initialized())
+        {
+            deinit();
+        }
+        // null terminated copy for atoi
+        SipPortT port(server_port);
+        m_server_port = atoi(port.c_str());
+    }
+
+    /**
+     * Clock that received datagrams are stamped with
+     */
+    template <class ClockT>
+    void set_clock(const ClockT& clock)
+    {
+        m_clock.set(clock);
+    }
+
+    void deinit()
+    {
+        if (!is_initialized())
+        {
+            return;
+        }
+        close(m_fd);
+        m_fd = -1;
+    }
+
+    bool init()
+    {
+        if (is_initialized())
+        {
+            logErrorP("Socket already initialized");
+            return false;
+        }
+        // host names are resolved once, a native build is not on the fast path
+        addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(m_server.c_str(), nullptr, &hints, &result) != 0 || result == nullptr)
+        {
+            logErrorP("Failed to resolve %s", m_server.c_str());
+            return false;
+        }
+        m_server_address = *(sockaddr_in*) result->ai_addr;
+        m_server_address.sin_port = htons(m_server_port);
+        freeaddrinfo(result);
+
+        m_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        if (m_fd < 0)
+        {
+            logErrorP("Failed to create socket, errno=%d", errno);
+            return false;
+        }
+        sockaddr_in local = {};
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        local.sin_port = htons(m_local_port);
+        if (bind(m_fd, (const sockaddr*) &local, sizeof(local)) != 0)
+        {
+            logErrorP("Failed to bind port %d, errno=%d", (int) m_local_port, errno);
+            deinit();
+            return false;
+        }
+        return true;
+    }
+
+    bool is_initialized() const
+    {
+        return m_fd >= 0;
+    }
+
+    /**
+     * A datagram is waiting, receive() will return it
+     */
+    bool has_pending()
+    {
+        poll();
+        return m_rx_ring.has_pending();
+    }
+
+    /**
+     * Take the next received datagram, nullptr if none is waiting.
+     * The datagram stays valid until the next call of receive().
+     */
+    const DatagramT* receive()
+    {
+        poll();
+        const DatagramT* datagram = m_rx_ring.receive();
+        if (datagram != nullptr)
+        {
+            logTraceP("Received %d bytes", (int) datagram->length);
+        }
+        return datagram;
+    }
+
+    /**
+     * The datagram with this remote address was sent by the server
+     */
+    bool is_server_address(uint32_t address) const
+    {
+        return address == m_server_address.sin_addr.s_addr;
+    }
+
+    const RingT& get_rx_ring() const
+    {
+        return m_rx_ring;
+    }
+
+    TxBufferT& get_new_tx_buf()
+    {
+        m_tx_buffer.clear();
+        return m_tx_buffer;
+    }
+
+    bool send_buffered_data()
+    {
+        if (m_tx_buffer.overflowed())
+        {
+            logErrorP("Message does not fit into %d bytes, not sent", (int) TX_BUFFER_SIZE);
+            return false;
+        }
+        if (!is_initialized())
+        {
+            return false;
+        }
+        logDebugP("Sending %d bytes", (int) m_tx_buffer.size());
+        auto result = sendto(m_fd, m_tx_buffer.data(), m_tx_buffer.size(), 0, (const sockaddr*) &m_server_address, sizeof(m_server_address));
+        if (result != (ssize_t) m_tx_buffer.size())
+        {
+            logErrorP("Failed to send data %d, errno=%d", (int) result, errno);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    /**
+     * Move the datagrams waiting in the socket into the ring, bounded per call
+     */
+    void poll()
+    {
+        if (!is_initialized())
+        {
+            return;
+        }
+        // datagrams that do not fit stay in the socket until the next poll
+        for (size_t i = 0; i < RX_SLOTS && m_rx_ring.has_free_slot(); i++)
+        {
+            char probe;
+            auto size = recv(m_fd, &probe, sizeof(probe), MSG_PEEK | MSG_TRUNC | MSG_DONTWAIT);
+            if (size < 0)
+            {
+                return;
+            }
+            auto slot = m_rx_ring.reserve(size);
+            if (slot == nullptr)
+            {
+                // dropped, remove it from the socket
+                recv(m_fd, &probe, sizeof(probe), MSG_DONTWAIT);
+                continue;
+            }
+            sockaddr_in remote = {};
+            socklen_t remote_length = sizeof(remote);
+            auto length = recvfrom(m_fd, slot->data.data(), slot->data.size(), MSG_DONTWAIT, (sockaddr*) &remote, &remote_length);
+            slot->length = length > 0 ? length : 0;
+            slot->remote_ip = remote.sin_addr.s_addr;
+            slot->remote_port = ntohs(remote.sin_port);
+            slot->received_at = m_clock.now();
+            m_rx_ring.commit();
+        }
+    }
+
+    SipHostT m_server;
+    uint16_t m_server_port;
+    sockaddr_in m_server_address = {};
+    const uint16_t m_local_port;
+    int m_fd = -1;
+    std::string m_logPrefix;
+    SipClockRef m_clock;
+
+    TxBufferT m_tx_buffer;
+    RingT m_rx_ring;
+};
+
+using PosixUdpClient = PosixUdpClientT<>;
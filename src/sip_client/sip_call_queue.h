@@ -0,0 +1,122 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Calls triggered by the channels, waiting in trigger order for a free dialog of the client.
+ *
+ * A channel has at most one call: a trigger while its call waits here, while the client
+ * still sets it up or lets it ring, or within the coalescing time after it was requested
+ * is merged into that call.
+ */
+template <size_t SIZE, size_t CHANNELS>
+class SipCallQueue
+{
+public:
+    enum class Push {
+        QUEUED,
+        COALESCED,
+        DROPPED,
+    };
+
+    explicit SipCallQueue(unsigned long coalesce_ms)
+        : m_coalesce_ms(coalesce_ms)
+    {
+    }
+
+    /**
+     * Queue a call of the channel unless it has one already
+     *
+     * \param[in] channel Index of the channel, below CHANNELS
+     * \param[in] now Time of the trigger in ms
+     * \param[in] is_call_active Tells whether a handle returned by request_ring() is still in use
+     */
+    template <class IsCallActiveT>
+    Push push(uint8_t channel, unsigned long now, IsCallActiveT&& is_call_active)
+    {
+        Channel& state = m_channels[channel];
+        if (state.queued || (state.requested_at != 0 && now - state.requested_at < m_coalesce_ms) || (state.call >= 0 && is_call_active(state.call))) {
+            m_coalesced++;
+            return Push::COALESCED;
+        }
+        if (m_count >= SIZE) {
+            m_dropped++;
+            return Push::DROPPED;
+        }
+        m_queue[(m_head + m_count) % SIZE] = channel;
+        m_count++;
+        m_queued++;
+        state.queued = true;
+        state.requested_at = now != 0 ? now : 1;
+        state.call = -1;
+        return Push::QUEUED;
+    }
+
+    bool empty() const
+    {
+        return m_count == 0;
+    }
+
+    /**
+     * Take the channel whose call is next, the caller starts it and reports the handle with started()
+     */
+    uint8_t pop()
+    {
+        uint8_t channel = m_queue[m_head];
+        m_head = (m_head + 1) % SIZE;
+        m_count--;
+        m_channels[channel].queued = false;
+        return channel;
+    }
+
+    /**
+     * The call of the channel was handed to the client
+     *
+     * \param[in] call Handle returned by request_ring(), -1 if the call was not accepted
+     */
+    void started(uint8_t channel, int call)
+    {
+        //a handle is reused once its call ended, it no longer belongs to the previous channel
+        for (Channel& other : m_channels) {
+            if (call >= 0 && other.call == call)
+                other.call = -1;
+        }
+        m_channels[channel].call = call;
+    }
+
+    uint8_t waiting() const
+    {
+        return m_count;
+    }
+
+    uint32_t queued() const
+    {
+        return m_queued;
+    }
+
+    uint32_t coalesced() const
+    {
+        return m_coalesced;
+    }
+
+    uint32_t dropped() const
+    {
+        return m_dropped;
+    }
+
+private:
+    struct Channel {
+        bool queued = false;
+        unsigned long requested_at = 0;
+        int call = -1;
+    };
+
+    unsigned long m_coalesce_ms;
+    Channel m_channels[CHANNELS];
+    uint8_t m_queue[SIZE];
+    uint8_t m_head = 0;
+    uint8_t m_count = 0;
+    uint32_t m_queued = 0;
+    uint32_t m_coalesced = 0;
+    uint32_t m_dropped = 0;
+};
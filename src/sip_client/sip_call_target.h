@@ -0,0 +1,40 @@
+#pragma once
+#include <string_view>
+
+#include "fixed_string.h"
+
+/**
+ * Request URI of a number to call, rendered once when number or server are known.
+ * Starting a call only copies it into the client, nothing is concatenated.
+ */
+class SipCallTarget
+{
+public:
+    void prepare(std::string_view number, std::string_view server)
+    {
+        m_number = number;
+        m_uri = "sip:";
+        m_uri += number;
+        m_uri += "@";
+        m_uri += server;
+    }
+
+    bool is_prepared() const
+    {
+        return !m_uri.empty();
+    }
+
+    const SipNumberT& get_number() const
+    {
+        return m_number;
+    }
+
+    const SipUriT& get_uri() const
+    {
+        return m_uri;
+    }
+
+private:
+    SipNumberT m_number;
+    SipUriT m_uri;
+};
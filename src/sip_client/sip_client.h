@@ -16,7 +16,14 @@
 
 #pragma once
 
+#include "sip_platform.h"
+#include "buffer.h"
+#include "datagram_ring.h"
+#include "fixed_string.h"
+#include "sip_call_target.h"
+#include "sip_framer.h"
 #include "sip_packet.h"
+#include "sip_transaction_timer.h"
 
 //#include "audio_client/audio_client.h"
 
@@ -28,6 +35,8 @@
 #include "boost/sml.hpp"
 #endif
 
+#include <algorithm>
+#include <array>
 #include <cstdlib>
 #include <functional>
 //#include <iomanip>
@@ -38,12 +47,22 @@
 #include <chrono>
 
 
+#ifndef SIP_MAX_DIALOGS
+#define SIP_MAX_DIALOGS 4
+#endif
+
+// incoming calls carry no media, they are hung up after this time
+#ifndef SIP_INCOMING_CALL_TIMEOUT_MS
+#define SIP_INCOMING_CALL_TIMEOUT_MS 60000
+#endif
+
 struct SipClientEvent {
     enum class Event {
         CALL_START,
         CALL_CANCELLED,
         CALL_END,
         BUTTON_PRESS,
+        TRANSACTION_TIMEOUT,
     };
 
     enum class CancelReason {
@@ -56,33 +75,34 @@ struct SipClientEvent {
     char button_signal = ' ';
     uint16_t button_duration = 0;
     CancelReason cancel_reason = CancelReason::UNKNOWN;
+    // call handle returned by request_ring(), -1 for the registration
+    int8_t call = -1;
 };
 
-template <class SocketT, class Md5T>
+template <class SocketT, class Md5T, class ClockT = SipMillisClock>
 class SipClientInt {
 public:
     SipClientInt(const std::string& user, const std::string& pwd, const std::string& server_ip, const std::string& server_port, const std::string& my_ip)
-        : m_socket(server_ip, server_port, LOCAL_PORT)
+        : m_logPrefix("SIP Client")
+        , m_socket(server_ip, server_port, LOCAL_PORT)
         // port wyciagnac z pakietu i ip rozmowcy wstawic
         , m_rtp_socket(server_ip, "7078", LOCAL_RTP_PORT)
         , m_server_ip(server_ip)
         , m_user(user)
         , m_pwd(pwd)
         , m_my_ip(my_ip)
-        , m_uri("sip:" + server_ip)
-        , m_to_uri("sip:" + user + "@" + server_ip)
-        , m_sip_sequence_number(std::rand() % 2147483647)
-        , m_call_id(std::rand() % 2147483647)
-        , m_response("")
-        , m_realm("")
-        , m_nonce("")
-        , m_currentReceiveMessage("")
-        , m_tag(std::rand() % 2147483647)
-        , m_branch(std::rand() % 2147483647)
-        , m_caller_display(m_user)
-        , m_sdp_session_id(0)
-        , m_logPrefix("SIP Client")
+        , m_register_call_id(std::rand() % 2147483647)
     {
+        if (m_user.size() < user.size() || m_pwd.size() < pwd.size() || m_server_ip.size() < server_ip.size() || m_my_ip.size() < my_ip.size())
+            logErrorP("Credentials or addresses too long");
+        m_register_uri = "sip:";
+        m_register_uri += m_server_ip;
+        m_registration.cseq = std::rand() % 2147483647;
+        m_registration.tag = std::rand() % 2147483647;
+        m_registration.branch = std::rand() % 2147483647;
+        m_socket.set_clock(m_clock);
+        m_rtp_socket.set_clock(m_clock);
+        render_fragments();
       //  xTaskCreate(&rtp_task, "rtp_task", 4096, &m_rtp_socket, 4, NULL);
     }
 
@@ -105,25 +125,53 @@ public:
         return m_socket.is_initialized();
     }
 
+    /**
+     * The network is gone: close the socket, forget the registration and end all calls
+     * without sending anything. The digest challenge and HA1 are kept, after init()
+     * the first REGISTER is already authenticated.
+     */
+    void stop()
+    {
+        m_socket.deinit();
+        for (Dialog& dialog : m_dialogs) {
+            if (dialog.state != SipState::IDLE)
+                end_call(dialog);
+        }
+        m_registration.transaction.stop();
+        m_registration.cseq++;
+        m_errorStarted = 0;
+        setState(SipState::IDLE);
+    }
+
     void set_server_ip(const std::string& server_ip)
     {
-        m_server_ip = server_ip;
+        if (m_server_ip != server_ip) {
+            //the challenges belong to the previous server
+            m_register_auth.nonce.clear();
+            m_invite_auth.nonce.clear();
+        }
+        if (!m_server_ip.assign(server_ip))
+            logErrorP("Server address too long");
         m_socket.set_server_ip(server_ip);
         m_rtp_socket.set_server_ip(server_ip);
-        m_uri = "sip:" + server_ip;
-        m_to_uri = "sip:" + m_user + "@" + server_ip;
+        m_register_uri = "sip:";
+        m_register_uri += m_server_ip;
+        render_fragments();
     }
 
     void set_my_ip(const std::string& my_ip)
     {
-        m_my_ip = my_ip;
+        if (!m_my_ip.assign(my_ip))
+            logErrorP("Local address too long");
+        render_fragments();
     }
 
     void set_credentials(const std::string& user, const std::string& password)
     {
-        m_user = user;
-        m_pwd = password;
-        m_to_uri = "sip:" + m_user + "@" + m_server_ip;
+        if (!m_user.assign(user) || !m_pwd.assign(password))
+            logErrorP("Credentials too long");
+        m_ha1_valid = false;
+        render_fragments();
     }
 
     void set_event_handler(std::function<void(const SipClientEvent&)> handler)
@@ -131,41 +179,119 @@ public:
         m_event_handler = handler;
     }
 
+    ClockT& get_clock()
+    {
+        return m_clock;
+    }
+
     bool isConnected()
     {
-        if (m_state == SipState::REGISTERED)
-            return true;
-        if (m_state == SipState::RINGING)
-            return true;
-        if (m_state == SipState::CALL_START)
-            return true;
-        if (m_state == SipState::CALL_IN_PROGRESS)
-            return true;
-        if (m_state == SipState::CANCELLED)
-            return true;
-        return false;
+        return m_state == SipState::REGISTERED || m_state == SipState::REGISTER_REFRESH;
     }
+
+    /**
+     * Registered and a free dialog is left, request_ring() will be accepted
+     */
+    bool isReadyToCall()
+    {
+        return isConnected() && find_dialog(SipState::IDLE) != nullptr;
+    }
+
+    /**
+     * Number of dialogs in use, outgoing and incoming
+     */
+    uint8_t get_active_calls() const
+    {
+        uint8_t count = 0;
+        for (const Dialog& dialog : m_dialogs) {
+            if (dialog.state != SipState::IDLE)
+                count++;
+        }
+        return count;
+    }
+
+    /**
+     * The call is set up, rings or is answered, its handle is not reused until it ended
+     *
+     * \param[in] call Handle returned by request_ring()
+     */
+    bool isCallActive(int call) const
+    {
+        return call >= 0 && call < (int)m_dialogs.size() && m_dialogs[call].state != SipState::IDLE;
+    }
+
     /**
      * Initiate a call async
      *
      * \param[in] local_number A number that is registered locally on the server, e.g. "**610"
      * \param[in] caller_display This string is displayed on the caller's phone
+     * \return Handle of the call or -1 if it was not accepted
+     */
+    int request_ring(const std::string& local_number, const std::string& caller_display)
+    {
+        SipCallTarget target;
+        target.prepare(local_number, m_server_ip);
+        return request_ring(target, caller_display.c_str());
+    }
+
+    /**
+     * Initiate a call async to a target that was prepared for the current server
+     *
+     * \param[in] target Rendered request URI of the number to call
+     * \param[in] caller_display This string is displayed on the caller's phone
+     * \param[in] cancel_after_ms The call is cancelled or hung up after this time, 0 to keep it
+     * \return Handle of the call or -1 if it was not accepted
      */
-    void request_ring(const std::string& local_number, const std::string& caller_display)
+    int request_ring(const SipCallTarget& target, const char* caller_display, unsigned long cancel_after_ms = 0)
     {
-        if (m_state == SipState::REGISTERED) {
-            logInfoP("Request to call %s...", local_number.c_str());
-            m_call_id = std::rand() % 2147483647;
-            m_uri = "sip:" + local_number + "@" + m_server_ip;
-            m_to_uri = "sip:" + local_number + "@" + m_server_ip;
-            m_caller_display = caller_display;
-            m_sipCommand = SipCommand::SipCommandDial;
+        if (!isConnected())
+            return -1;
+        Dialog* dialog = find_dialog(SipState::IDLE);
+        if (dialog == nullptr) {
+            logInfoP("No free dialog to call %s", target.get_number().c_str());
+            return -1;
+        }
+        int call = dialog - m_dialogs.data();
+        logInfoP("Request to call %s as call %d...", target.get_number().c_str(), call);
+        reset_dialog(*dialog, cancel_after_ms);
+        dialog->call_id << (uint32_t)(std::rand() % 2147483647) << m_call_id_suffix;
+        dialog->uri.assign(target.get_uri());
+        dialog->to_uri.assign(target.get_uri());
+        if (!dialog->caller_display.assign(caller_display)) {
+            logInfoP("Caller name cut to %d characters", (int)SipDisplayT::capacity());
         }
+        //the SDP offer only differs in the session id of the origin line, it is joined once per call
+        uint32_t sdp_session_id = std::rand();
+        dialog->sdp << m_sdp_origin << sdp_session_id << " " << sdp_session_id << m_sdp_tail;
+        //reuse the nonce of the last challenge and skip the unauthenticated INVITE,
+        //before the first INVITE was challenged the one of the REGISTER is tried
+        if (m_invite_auth.nonce.empty())
+            m_invite_auth = m_register_auth;
+        dialog->preemptive_auth = !m_invite_auth.nonce.empty() && m_ha1_valid;
+        setState(*dialog, dialog->preemptive_auth ? SipState::INVITE_AUTH : SipState::INVITE_UNAUTH);
+        return call;
     }
 
+    /**
+     * Cancel or hang up all calls
+     */
     void request_cancel()
     {
-        m_sipCommand = SipCommand::SipCommandCancel;
+        for (Dialog& dialog : m_dialogs) {
+            if (dialog.state != SipState::IDLE)
+                dialog.cancel_requested = true;
+        }
+    }
+
+    /**
+     * Cancel or hang up one call
+     *
+     * \param[in] call Handle returned by request_ring()
+     */
+    void request_cancel(int call)
+    {
+        if (call >= 0 && call < (int)m_dialogs.size() && m_dialogs[call].state != SipState::IDLE)
+            m_dialogs[call].cancel_requested = true;
     }
 
     void run()
@@ -183,20 +309,66 @@ private:
         REGISTER_UNAUTH,
         REGISTER_AUTH,
         REGISTERED,
+        REGISTER_REFRESH,
         INVITE_UNAUTH,
         INVITE_UNAUTH_SENT,
         INVITE_AUTH,
         RINGING,
         CALL_START,
         CALL_IN_PROGRESS,
-        CANCELLED,
+        CANCELLING,
+        BYE_SENT,
         ERROR,
     };
 
-    enum class SipCommand {
-        SipCommandIdle,
-        SipCommandDial,
-        SipCommandCancel,
+    static constexpr const size_t HEX_DIGEST_SIZE = 33;
+
+    /**
+     * Request state shared by all transactions of one Call-ID.
+     * The registration uses one, every call another one from m_dialogs.
+     * A dialog with state IDLE is free.
+     */
+    struct Dialog {
+        SipState state = SipState::IDLE;
+        Buffer<80> call_id;
+        uint32_t cseq = 0;
+        uint32_t tag = 0;
+        uint32_t branch = 0;
+        SipTransactionTimer transaction;
+        char response[HEX_DIGEST_SIZE] = "";
+        char nonce_count[9] = "";
+
+        SipUriT uri;
+        SipUriT to_uri;
+        SipTagT to_tag;
+        SipUriT to_contact;
+        SipDisplayT caller_display;
+        // SDP offer of the INVITE, rendered once by request_ring()
+        Buffer<512> sdp;
+        bool preemptive_auth = false;
+        bool auth_retried = false;
+        // INVITE whose final response was acknowledged last, its ACK is repeated if the response comes again
+        bool ack_sent = false;
+        bool ack_answered = false;
+        uint32_t ack_cseq = 0;
+        uint32_t ack_branch = 0;
+        volatile bool cancel_requested = false;
+        unsigned long started = 0;
+        unsigned long cancel_after_ms = 0;
+    };
+
+    /**
+     * Last digest challenge of one kind of request, with the nonce count and client nonce
+     * of the responses to it
+     */
+    struct DigestChallenge {
+        SipRealmT realm;
+        SipNonceT nonce;
+        SipNonceT opaque;
+        bool qop_auth = false;
+        bool proxy_auth = false;
+        uint32_t nonce_count = 0;
+        char cnonce[9] = "";
     };
 
     static const char* getStateName(SipState state)
@@ -211,6 +383,8 @@ private:
             return "register auth";
         case SipState::REGISTERED:
             return "registered";
+        case SipState::REGISTER_REFRESH:
+            return "register refresh";
         case SipState::INVITE_UNAUTH:
             return "invite unauth";
         case SipState::INVITE_UNAUTH_SENT:
@@ -223,8 +397,10 @@ private:
             return "call start";
         case SipState::CALL_IN_PROGRESS:
             return "call in progress";
-        case SipState::CANCELLED:
-            return "cancelled";
+        case SipState::CANCELLING:
+            return "cancelling";
+        case SipState::BYE_SENT:
+            return "bye sent";
         case SipState::ERROR:
             return "error";
         default:
@@ -234,354 +410,693 @@ private:
 
     void tx()
     {
-        if (m_lastSent != 0)
-        {
-            if (millis() - m_lastSent < 1000)
-                return;
-            m_lastSent = 0;
+        auto now = m_clock.now();
+        tx_registration(now);
+        for (Dialog& dialog : m_dialogs) {
+            if (dialog.state != SipState::IDLE)
+                tx_dialog(dialog, now);
         }
-        if (m_receivedStarted != 0)
-            return;
-        if (m_sipCommand == SipCommand::SipCommandCancel)
+    }
+
+    void tx_registration(unsigned long now)
+    {
+        Dialog& reg = m_registration;
+        bool retransmit = false;
+        if (reg.transaction.is_active())
         {
-            m_sipCommand = SipCommand::SipCommandIdle;
-            if (m_state == SipState::CALL_IN_PROGRESS)
-                send_sip_bye();
-            else
-                send_sip_cancel();
-            setState(SipState::IDLE);
-            return;
+            if (reg.transaction.is_timed_out(now))
+            {
+                reg.transaction.stop();
+                setState(SipState::ERROR, "Transaction timeout");
+                notify(SipClientEvent{ SipClientEvent::Event::TRANSACTION_TIMEOUT });
+                return;
+            }
+            retransmit = reg.transaction.retransmit_due(now);
+            if (!retransmit)
+                return;
+            logDebugP("Retransmit request in state '%s'", getStateName(m_state));
         }
         switch (m_state) {
         case SipState::IDLE:
+            reg.tag = std::rand() % 2147483647;
+            if (!m_register_auth.nonce.empty() && m_ha1_valid) {
+                //reuse the nonce of the last challenge, a rejected one is answered once
+                reg.auth_retried = false;
+                setState(SipState::REGISTER_AUTH);
+                tx_registration(now);
+                return;
+            }
+            setState(SipState::REGISTER_UNAUTH);
             //fall-through
         case SipState::REGISTER_UNAUTH:
-            //sending REGISTER without auth
-            m_tag = std::rand() % 2147483647;
-            m_branch = std::rand() % 2147483647;
+            //sending REGISTER without auth, every new transaction needs its own branch
+            if (!retransmit)
+                reg.branch = std::rand() % 2147483647;
             send_sip_register();
-            m_tag = std::rand() % 2147483647;
-            m_branch = std::rand() % 2147483647;
+            if (!retransmit)
+                reg.transaction.start(now, false);
             break;
         case SipState::REGISTER_AUTH:
-            //sending REGISTER with auth
-            compute_auth_response("REGISTER", "sip:" + m_server_ip);
+        case SipState::REGISTER_REFRESH:
+            //sending REGISTER with auth, a refresh reuses the nonce of the last challenge
+            if (!retransmit) {
+                reg.branch = std::rand() % 2147483647;
+                if (m_register_auth.nonce.empty())
+                    reg.response[0] = '\0';
+                else
+                    compute_auth_response("REGISTER", m_register_uri, reg);
+            }
             send_sip_register();
+            if (!retransmit)
+                reg.transaction.start(now, false);
             break;
         case SipState::REGISTERED:
-            //wait for request
+            //wait for request or refresh the registration before it expires
+            if (now - m_registered_since >= m_register_refresh_ms) {
+                reg.auth_retried = false;
+                setState(SipState::REGISTER_REFRESH);
+            }
             break;
+        default:
+            break;
+        }
+    }
+
+    void tx_dialog(Dialog& dialog, unsigned long now)
+    {
+        if (dialog.cancel_after_ms != 0 && now - dialog.started >= dialog.cancel_after_ms)
+        {
+            logDebugP("Cancel call %d", call_of(dialog));
+            dialog.cancel_after_ms = 0;
+            dialog.cancel_requested = true;
+        }
+        if (dialog.cancel_requested)
+        {
+            dialog.cancel_requested = false;
+            switch (dialog.state) {
+            case SipState::CALL_START:
+            case SipState::CALL_IN_PROGRESS:
+                //BYE is a new request within the dialog
+                dialog.cseq++;
+                dialog.branch = std::rand() % 2147483647;
+                setState(dialog, SipState::BYE_SENT);
+                send_sip_bye(dialog);
+                dialog.transaction.start(now, false);
+                return;
+            case SipState::INVITE_AUTH:
+                if (!dialog.transaction.is_active()) {
+                    //authenticated INVITE not sent yet, the first one is already acknowledged
+                    end_call(dialog);
+                    return;
+                }
+                //fall-through
+            case SipState::INVITE_UNAUTH_SENT:
+            case SipState::RINGING:
+                //CANCEL uses branch and CSeq of the INVITE
+                setState(dialog, SipState::CANCELLING);
+                send_sip_cancel(dialog);
+                dialog.transaction.start(now, false);
+                return;
+            case SipState::INVITE_UNAUTH:
+                //INVITE not sent yet
+                end_call(dialog);
+                return;
+            default:
+                break;
+            }
+        }
+        bool retransmit = false;
+        if (dialog.transaction.is_active())
+        {
+            if (dialog.transaction.is_timed_out(now))
+            {
+                dialog.transaction.stop();
+                bool invite = dialog.state != SipState::CANCELLING && dialog.state != SipState::BYE_SENT;
+                end_call(dialog);
+                if (invite)
+                    //the server does not answer anymore, register again
+                    setState(SipState::ERROR, "Transaction timeout");
+                notify(SipClientEvent{ SipClientEvent::Event::TRANSACTION_TIMEOUT }, dialog);
+                return;
+            }
+            retransmit = dialog.transaction.retransmit_due(now);
+            if (!retransmit)
+                return;
+            logDebugP("Retransmit request of call %d in state '%s'", call_of(dialog), getStateName(dialog.state));
+        }
+        switch (dialog.state) {
         case SipState::INVITE_UNAUTH:
             //sending INVITE without auth
-            //m_tag = std::rand() % 2147483647;
-            m_sdp_session_id = std::rand();
-            send_sip_invite();
-            break;
+            dialog.branch = std::rand() % 2147483647;
+            setState(dialog, SipState::INVITE_UNAUTH_SENT);
+            //fall-through
         case SipState::INVITE_UNAUTH_SENT:
+            send_sip_invite(dialog);
+            if (!retransmit)
+                dialog.transaction.start(now, true);
             break;
         case SipState::INVITE_AUTH:
             //sending INVITE with auth
-            m_branch = std::rand() % 2147483647;
-            compute_auth_response("INVITE", m_uri);
-            send_sip_invite();
+            if (!retransmit) {
+                dialog.branch = std::rand() % 2147483647;
+                compute_auth_response("INVITE", dialog.uri, dialog);
+            }
+            send_sip_invite(dialog);
+            if (!retransmit)
+                dialog.transaction.start(now, true);
             break;
         case SipState::RINGING:
             // RTP ssrc generation
             //ssrc = std::rand() % 2147483647;
-            
+
             break;
         case SipState::CALL_START:
-            send_sip_ack();
+            send_sip_ack(dialog, true);
+            setState(dialog, SipState::CALL_IN_PROGRESS);
             break;
-        case SipState::CALL_IN_PROGRESS:
+        case SipState::CANCELLING:
+            send_sip_cancel(dialog);
             break;
-        case SipState::CANCELLED:
-            send_sip_ack();
-            m_tag = std::rand() % 2147483647;
-            m_branch = std::rand() % 2147483647;
+        case SipState::BYE_SENT:
+            send_sip_bye(dialog);
             break;
-        case SipState::ERROR:
+        default:
             break;
         }
     }
 
     void rx()
     {
-        if (m_state == SipState::ERROR) {              
-            if (millis() - m_errorStarted < 1000)
-                return;
-            m_errorStarted = 0;
-            m_sip_sequence_number++;
-            setState(SipState::IDLE);
-            return;
-        }
-        if (m_receivedStarted == 0)
-        {
-            if (m_sipCommand == SipCommand::SipCommandDial)
-            {
-                m_sipCommand = SipCommand::SipCommandIdle;
-                if (m_state == SipState::REGISTERED)
-                     setState(SipState::INVITE_UNAUTH);
-                return;
+        if (m_state == SipState::ERROR) {
+            if (m_clock.now() - m_errorStarted >= 1000) {
+                m_errorStarted = 0;
+                m_registration.cseq++;
+                setState(SipState::IDLE);
             }
-            if (m_state == SipState::INVITE_UNAUTH) {
-                setState(SipState::INVITE_UNAUTH_SENT);
-                return;
-            } else if (m_state == SipState::CALL_START) {
-                setState(SipState::CALL_IN_PROGRESS);
-                return;
-            }           
-        }
-       
-        // The timeout is a workaround to be able to end a CANCEL request during ring
-        //std::string recv_string = m_socket.receive(SOCKET_RX_TIMEOUT_MSEC);
-        auto now = millis();
-        if (now == 0)
-            now = 1;
-        if (m_receivedStarted == 0)
-        {
-            m_currentReceiveMessage == "";
-            m_receivedStarted = now;
         }
-        std::string temp = m_socket.receive(0);
-        m_currentReceiveMessage += temp;
-        if (now - m_receivedStarted < SOCKET_RX_TIMEOUT_MSEC)
-            return;
-        m_receivedStarted = 0;
-        std::string recv_string = m_currentReceiveMessage;
-        m_currentReceiveMessage = "";
 
+        // Every received datagram is handled as soon as it arrives, parallel calls
+        // answer in bursts, so up to a full receive queue is handled per pass
+        for (size_t i = 0; i < RX_QUEUE_SLOTS && m_socket.has_pending(); i++) {
+            auto datagram = m_socket.receive();
+            if (datagram == nullptr || datagram->length == 0) {
+                continue;
+            }
+            logTraceP("Datagram waited %lu ms in the receive queue", m_clock.now() - datagram->received_at);
 
-        if (recv_string.empty()) {
-            return;
+            SipFramer framer(datagram->data.data(), datagram->length);
+            std::string_view message;
+            while (framer.next(message)) {
+                process_message(message, datagram->remote_ip);
+            }
         }
+    }
 
-        SipPacket packet(recv_string.c_str(), recv_string.size());
+    void process_message(std::string_view message, uint32_t remote_ip)
+    {
+        SipPacket packet(message.data(), message.size());
         if (!packet.parse()) {
             logInfoP("Parsing the packet failed");
             return;
         }
 
-        SipPacket::Status reply = packet.get_status();
         logInfoP("Parsing the packet ok, reply code=%d", (int)packet.get_status());
 
-        if (reply == SipPacket::Status::SERVER_ERROR_500) {
-            setState(SipState::ERROR, "SERVER_ERROR_500");
+        if (!packet.is_response()) {
+            process_request(packet, remote_ip);
             return;
-        } else if ((reply == SipPacket::Status::UNAUTHORIZED_401) || (reply == SipPacket::Status::PROXY_AUTH_REQ_407)) {
-            m_realm = packet.get_realm();
-            m_nonce = packet.get_nonce();
-        } else if ((reply == SipPacket::Status::UNKNOWN) && ((packet.get_method() == SipPacket::Method::NOTIFY) || (packet.get_method() == SipPacket::Method::BYE) || (packet.get_method() == SipPacket::Method::INFO) || (packet.get_method() == SipPacket::Method::INVITE))) {
-            send_sip_ok(packet);
-            if ((packet.get_method() == SipPacket::Method::INVITE)) {
-                std::string media = packet.get_media();
-                std::string::size_type m1 = media.find(' ');
-                std::string::size_type m2 = media.find(' ', m1 + 1);
-                rtp_port = media.substr(m1 + 1, m2 - m1 - 1);
-                // inicjalizacja rtp
-                //std::cout << rtp_port;
-                m_rtp_socket.set_server_ip(packet.get_cip());
-                m_rtp_socket.set_server_port(rtp_port);
-                m_rtp_socket.init();
+        }
+
+        Dialog* dialog = packet.get_cseq_method() == SipPacket::Method::REGISTER ? &m_registration : find_dialog(packet.get_call_id());
+        if (packet.get_cseq_method() == SipPacket::Method::INVITE && packet.is_final_response()) {
+            Dialog* acked = find_acked_dialog(packet.get_call_id(), packet.get_cseq_number());
+            if (acked != nullptr) {
+                //the server did not get the ACK and repeats its final response
+                logDebugP("Repeat the ACK of call %d", call_of(*acked));
+                if (!packet.get_contact().empty())
+                    acked->to_contact.assign(packet.get_contact());
+                if (!packet.get_to_tag().empty())
+                    acked->to_tag.assign(packet.get_to_tag());
+                repeat_sip_ack(*acked);
+                return;
             }
         }
+        if (dialog == nullptr || (dialog == &m_registration && packet.get_call_id() != m_registration.call_id.view())) {
+            logDebugP("Ignore response for unknown Call-ID");
+            return;
+        }
+        if (packet.get_cseq_number() != 0 && packet.get_cseq_number() != dialog->cseq) {
+            //retransmitted response of an already completed transaction
+            logDebugP("Ignore response for CSeq %u, current CSeq is %u", packet.get_cseq_number(), dialog->cseq);
+            return;
+        }
+        if (packet.is_provisional_response() && packet.get_cseq_method() == transaction_method(*dialog)) {
+            //a late 1xx of the INVITE must not slow down the CANCEL
+            dialog->transaction.provisional();
+        }
+        if ((packet.get_status() == SipPacket::Status::UNAUTHORIZED_401) || (packet.get_status() == SipPacket::Status::PROXY_AUTH_REQ_407)) {
+            store_challenge(packet, challenge_of(*dialog));
+        }
 
-        if (!packet.get_contact().empty()) {
-            m_to_contact = packet.get_contact();
+        if (dialog == &m_registration) {
+            process_register_response(packet);
+            return;
         }
 
-        if (!packet.get_to_tag().empty()) {
-            m_to_tag = packet.get_to_tag();
+        if (!packet.get_contact().empty() && !dialog->to_contact.assign(packet.get_contact())) {
+            logErrorP("Contact of call %d too long, requests in the dialog will be malformed", call_of(*dialog));
         }
 
+        if (!packet.get_to_tag().empty() && !dialog->to_tag.assign(packet.get_to_tag())) {
+            logErrorP("To tag of call %d too long, requests in the dialog will be rejected", call_of(*dialog));
+        }
+        process_dialog_response(*dialog, packet);
+    }
+
+    void process_request(const SipPacket& packet, uint32_t remote_ip)
+    {
+        SipPacket::Method method = packet.get_method();
+        if ((method == SipPacket::Method::NOTIFY) || (method == SipPacket::Method::BYE) || (method == SipPacket::Method::INFO)) {
+            send_sip_ok(packet);
+        }
+        Dialog* dialog = find_dialog(packet.get_call_id());
+        switch (method) {
+        case SipPacket::Method::INVITE:
+        {
+            if (!m_socket.is_server_address(remote_ip)) {
+                logInfoP("Ignore INVITE that was not sent by the server");
+                break;
+            }
+            bool new_call = dialog == nullptr;
+            if (new_call) {
+                //someone called us
+                if (isConnected())
+                    dialog = find_dialog(SipState::IDLE);
+                if (dialog == nullptr) {
+                    logInfoP("No free dialog for the incoming call");
+                    send_sip_reply("486 Busy Here", packet);
+                    break;
+                }
+                reset_dialog(*dialog, SIP_INCOMING_CALL_TIMEOUT_MS);
+                dialog->call_id << packet.get_call_id();
+                dialog->uri.assign(packet.get_contact());
+                dialog->to_uri.assign(packet.get_from_uri());
+                dialog->to_tag.assign(packet.get_from_tag());
+                dialog->to_contact.assign(packet.get_contact());
+                if (dialog->call_id.overflowed() || dialog->to_uri.size() < packet.get_from_uri().size()
+                    || dialog->to_tag.size() < packet.get_from_tag().size() || dialog->to_contact.size() < packet.get_contact().size()) {
+                    logErrorP("Incoming call with too long headers rejected");
+                    end_call(*dialog);
+                    send_sip_reply("500 Server Internal Error", packet);
+                    break;
+                }
+            }
+            //a retransmitted INVITE gets the same answer
+            send_sip_reply("200 OK", packet, dialog->tag);
+            if (new_call) {
+                setState(*dialog, SipState::CALL_IN_PROGRESS);
+                notify(SipClientEvent{ SipClientEvent::Event::CALL_START }, *dialog);
+            }
+            std::string_view media = packet.get_media();
+            std::string_view::size_type m1 = media.find(' ');
+            std::string_view::size_type m2 = media.find(' ', m1 + 1);
+            if (!rtp_port.assign(media.substr(m1 + 1, m2 - m1 - 1))) {
+                logErrorP("Invalid media port in the offer of call %d", call_of(*dialog));
+                break;
+            }
+            // inicjalizacja rtp
+            //std::cout << rtp_port;
+            m_rtp_socket.set_server_ip(packet.get_cip());
+            m_rtp_socket.set_server_port(rtp_port);
+            m_rtp_socket.init();
+            break;
+        }
+        case SipPacket::Method::BYE:
+            if (dialog != nullptr && (dialog->state == SipState::CALL_START || dialog->state == SipState::CALL_IN_PROGRESS)) {
+                end_call(*dialog);
+                notify(SipClientEvent{ SipClientEvent::Event::CALL_END }, *dialog);
+            }
+            break;
+        case SipPacket::Method::INFO:
+            if (dialog != nullptr && dialog->state == SipState::CALL_IN_PROGRESS
+                && (packet.get_content_type() == SipPacket::ContentType::APPLICATION_DTMF_RELAY)) {
+                notify(SipClientEvent{ SipClientEvent::Event::BUTTON_PRESS, packet.get_dtmf_signal(), packet.get_dtmf_duration() }, *dialog);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    void process_register_response(const SipPacket& packet)
+    {
+        SipPacket::Status reply = packet.get_status();
+        if (reply == SipPacket::Status::SERVER_ERROR_500) {
+            setState(SipState::ERROR, "SERVER_ERROR_500");
+            return;
+        }
         switch (m_state) {
         case SipState::IDLE:
             //fall-trough
         case SipState::REGISTER_UNAUTH:
+            if (reply == SipPacket::Status::TRYING_100)
+                break;
+            if (reply == SipPacket::Status::OK_200) {
+                registered(packet);
+                break;
+            }
+            if (reply == SipPacket::Status::INTERVAL_TOO_BRIEF_423) {
+                retry_register_with_min_expires(packet);
+                break;
+            }
             setState(SipState::REGISTER_AUTH);
-            m_sip_sequence_number++;
+            //the challenge is fresh, a second one means wrong credentials
+            m_registration.auth_retried = true;
+            m_registration.cseq++;
+            m_registration.tag = std::rand() % 2147483647;
             break;
         case SipState::REGISTER_AUTH:
-            if (reply == SipPacket::Status::OK_200) {
-                m_sip_sequence_number++;
-                m_nonce = "";
-                m_realm = "";
-                m_response = "";
-
-                logInfoP("REGISTER - OK :)");
-                m_uri = "sip:**613@" + m_server_ip;
-                m_to_uri = "sip:**613@" + m_server_ip;
-                setState(SipState::REGISTERED);
+        case SipState::REGISTER_REFRESH:
+            if (reply == SipPacket::Status::TRYING_100) {
+                break;
+            } else if (reply == SipPacket::Status::OK_200) {
+                registered(packet);
+            } else if (reply == SipPacket::Status::INTERVAL_TOO_BRIEF_423) {
+                retry_register_with_min_expires(packet);
+            } else if (!m_registration.auth_retried
+                && ((reply == SipPacket::Status::UNAUTHORIZED_401) || (reply == SipPacket::Status::PROXY_AUTH_REQ_407))) {
+                //cached nonce expired, answer the new challenge once
+                m_registration.auth_retried = true;
+                m_registration.cseq++;
+                m_registration.transaction.stop();
             } else {
                 setState(SipState::ERROR, "Wrong Reply");
-                return;
             }
             break;
-        case SipState::REGISTERED:
-            if (packet.get_method() == SipPacket::Method::INVITE) {
-                //received an invite, answered it already with ok, so new call is established, because someone called us
-                setState(SipState::CALL_START);
-                if (m_event_handler) {
-                    m_event_handler(SipClientEvent{ SipClientEvent::Event::CALL_START });
-                }
-            }
+        default:
             break;
+        }
+    }
+
+    void process_dialog_response(Dialog& dialog, const SipPacket& packet)
+    {
+        SipPacket::Status reply = packet.get_status();
+        switch (dialog.state) {
         case SipState::INVITE_UNAUTH_SENT:
         case SipState::INVITE_UNAUTH:
             if ((reply == SipPacket::Status::UNAUTHORIZED_401) || (reply == SipPacket::Status::PROXY_AUTH_REQ_407)) {
-                setState( SipState::INVITE_AUTH);
-                send_sip_ack();
-                m_sip_sequence_number++;
-            } else if ((reply == SipPacket::Status::OK_200) || (reply == SipPacket::Status::SESSION_PROGRESS_183)) {
-                setState(SipState::RINGING);
-                m_nonce = "";
-                m_realm = "";
-                m_response = "";
+                setState(dialog, SipState::INVITE_AUTH);
+                send_sip_ack(dialog);
+                dialog.cseq++;
+            } else if (reply == SipPacket::Status::OK_200) {
+                answered(dialog);
+            } else if ((reply == SipPacket::Status::RINGING_180) || (reply == SipPacket::Status::SESSION_PROGRESS_183)) {
+                setState(dialog, SipState::RINGING);
+                dialog.response[0] = '\0';
                 logTraceP("Start RINGing...");
-            } else if (reply != SipPacket::Status::TRYING_100) {
-                setState(SipState::ERROR, "TRYING_100");
-                return;
+            } else if (packet.is_error_response()) {
+                call_failed(dialog, packet);
             }
             break;
         case SipState::INVITE_AUTH:
-            if (reply == SipPacket::Status::UNAUTHORIZED_401) {
-                setState(SipState::ERROR, "UNAUTHORIZED_401");
-                return;
-            } else if (reply == SipPacket::Status::PROXY_AUTH_REQ_407) {
-               setState(SipState::ERROR, "PROXY_AUTH_REQ_407");
-               return;
-            } else if ((reply == SipPacket::Status::OK_200) || (reply == SipPacket::Status::SESSION_PROGRESS_183) || (reply == SipPacket::Status::TRYING_100)) {
+            if ((reply == SipPacket::Status::UNAUTHORIZED_401) || (reply == SipPacket::Status::PROXY_AUTH_REQ_407)) {
+                if (dialog.auth_retried || !(dialog.preemptive_auth || packet.is_stale())) {
+                    send_sip_ack(dialog);
+                    end_call(dialog);
+                    setState(SipState::ERROR, reply == SipPacket::Status::UNAUTHORIZED_401 ? "UNAUTHORIZED_401" : "PROXY_AUTH_REQ_407");
+                    return;
+                }
+                //the reused nonce was rejected, answer the new challenge once
+                logDebugP("Nonce rejected, answer the new challenge");
+                dialog.auth_retried = true;
+                dialog.preemptive_auth = false;
+                send_sip_ack(dialog);
+                dialog.cseq++;
+                dialog.transaction.stop();
+            } else if (reply == SipPacket::Status::OK_200) {
+                answered(dialog);
+            } else if (packet.is_provisional_response()) {
                 //trying is not yet ringing, but change state to not send invite again
-                setState(SipState::RINGING);
-                m_nonce = "";
-                m_realm = "";
-                m_response = "";
+                setState(dialog, SipState::RINGING);
+                dialog.response[0] = '\0';
 
                 logTraceP("Start RINGing...");
 
-            } else {
-                setState(SipState::ERROR, "Invalid INVITE_AUTH reply");
-                return;
+            } else if (packet.is_error_response()) {
+                call_failed(dialog, packet);
             }
             break;
         case SipState::RINGING:
-            if (reply == SipPacket::Status::SESSION_PROGRESS_183) {
+            if (packet.is_provisional_response()) {
                 //TODO parse session progress reply and send appropriate answer
-                //m_state = SipState::ERROR;
             } else if (reply == SipPacket::Status::OK_200) {
-                //other side picked up, send an ack
-                setState(SipState::CALL_START);
-                if (m_event_handler) {
-                    m_event_handler(SipClientEvent{ SipClientEvent::Event::CALL_START });
-                }
-            } else if (reply == SipPacket::Status::REQUEST_CANCELLED_487) {
-                setState(SipState::CANCELLED);
-                if (m_event_handler) {
-                    m_event_handler(SipClientEvent{ SipClientEvent::Event::CALL_CANCELLED });
-                }
+                answered(dialog);
             } else if (reply == SipPacket::Status::PROXY_AUTH_REQ_407) {
-                send_sip_ack();
-                m_sip_sequence_number++;
-                setState(SipState::INVITE_AUTH);
+                send_sip_ack(dialog);
+                dialog.cseq++;
+                setState(dialog, SipState::INVITE_AUTH);
                 logTraceP("Go back to send invite with auth...");
-            } else if ((reply == SipPacket::Status::DECLINE_603) || (reply == SipPacket::Status::BUSY_HERE_486)) {
-                send_sip_ack();
-                m_sip_sequence_number++;
-                m_branch = std::rand() % 2147483647;
-                setState(SipState::REGISTERED);
-                SipClientEvent::CancelReason cancel_reason = SipClientEvent::CancelReason::CALL_DECLINED;
-                if (reply == SipPacket::Status::BUSY_HERE_486) {
-                    cancel_reason = SipClientEvent::CancelReason::TARGET_BUSY;
-                }
-                if (m_event_handler) {
-                    m_event_handler(SipClientEvent{ SipClientEvent::Event::CALL_CANCELLED, ' ', 0, cancel_reason });
-                }
+            } else if (packet.is_error_response()) {
+                //487 after a CANCEL of the server, 486 busy, 603 declined, or any other failure
+                call_failed(dialog, packet);
             }
             break;
-        case SipState::CALL_START:
-            //should not reach this point
-            break;
-        case SipState::CALL_IN_PROGRESS:
-            if (packet.get_method() == SipPacket::Method::BYE) {
-                m_sip_sequence_number++;
-                setState(SipState::REGISTERED);
-                if (m_event_handler) {
-                    m_event_handler(SipClientEvent{ SipClientEvent::Event::CALL_END });
-                }
-            } else if ((packet.get_method() == SipPacket::Method::INFO)
-                && (packet.get_content_type() == SipPacket::ContentType::APPLICATION_DTMF_RELAY)) {
-                if (m_event_handler) {
-                    m_event_handler(SipClientEvent{ SipClientEvent::Event::BUTTON_PRESS, packet.get_dtmf_signal(), packet.get_dtmf_duration() });
+        case SipState::CANCELLING:
+            if (packet.get_cseq_method() == SipPacket::Method::CANCEL) {
+                if (reply == SipPacket::Status::OK_200) {
+                    //CANCEL accepted, the INVITE is answered with 487
+                    dialog.transaction.wait(m_clock.now());
+                } else if (packet.is_final_response()) {
+                    //no matching INVITE transaction left on the server
+                    end_call(dialog);
                 }
+            } else if (reply == SipPacket::Status::OK_200) {
+                //the call was answered before the CANCEL arrived, hang up
+                send_sip_ack(dialog, true);
+                dialog.cseq++;
+                dialog.branch = std::rand() % 2147483647;
+                setState(dialog, SipState::BYE_SENT);
+                send_sip_bye(dialog);
+                dialog.transaction.start(m_clock.now(), false);
+            } else if (packet.is_final_response()) {
+                //487 or any other final response of the INVITE
+                send_sip_ack(dialog);
+                end_call(dialog);
+                notify(SipClientEvent{ SipClientEvent::Event::CALL_CANCELLED }, dialog);
             }
             break;
-        case SipState::CANCELLED:
-            if (reply == SipPacket::Status::OK_200) {
-                m_sip_sequence_number++;
-                setState(SipState::REGISTERED);
+        case SipState::BYE_SENT:
+            if (packet.get_cseq_method() == SipPacket::Method::BYE && packet.is_final_response()) {
+                end_call(dialog);
+                notify(SipClientEvent{ SipClientEvent::Event::CALL_END }, dialog);
             }
-            else
-                setState(SipState::ERROR, "No Cancel Ack");
             break;
-        case SipState::ERROR:
-            m_sip_sequence_number++;
-            setState(SipState::IDLE);
+        default:
             break;
         }
+    }
+
+    /**
+     * The INVITE got an error response: acknowledge it, the registration stays valid
+     */
+    void call_failed(Dialog& dialog, const SipPacket& packet)
+    {
+        logInfoP("Call %d failed with %d", call_of(dialog), (int)packet.get_status_code());
+        send_sip_ack(dialog);
+        end_call(dialog);
+        SipClientEvent::CancelReason cancel_reason = SipClientEvent::CancelReason::UNKNOWN;
+        if (packet.get_status() == SipPacket::Status::DECLINE_603) {
+            cancel_reason = SipClientEvent::CancelReason::CALL_DECLINED;
+        } else if (packet.get_status() == SipPacket::Status::BUSY_HERE_486) {
+            cancel_reason = SipClientEvent::CancelReason::TARGET_BUSY;
+        }
+        notify(SipClientEvent{ SipClientEvent::Event::CALL_CANCELLED, ' ', 0, cancel_reason }, dialog);
+    }
+
+    /**
+     * The other side picked up, tx_dialog() sends the ACK
+     */
+    void answered(Dialog& dialog)
+    {
+        dialog.response[0] = '\0';
+        setState(dialog, SipState::CALL_START);
+        notify(SipClientEvent{ SipClientEvent::Event::CALL_START }, dialog);
+    }
+
+    /**
+     * Clear everything the previous call left in the slot and start a new dialog in it
+     *
+     * \param[in] cancel_after_ms The call is ended after this time, 0 to keep it
+     */
+    void reset_dialog(Dialog& dialog, unsigned long cancel_after_ms)
+    {
+        dialog.call_id.clear();
+        dialog.cseq = std::rand() % 2147483647;
+        dialog.tag = std::rand() % 2147483647;
+        dialog.branch = std::rand() % 2147483647;
+        dialog.transaction.stop();
+        dialog.response[0] = '\0';
+        dialog.nonce_count[0] = '\0';
+        dialog.uri.clear();
+        dialog.to_uri.clear();
+        dialog.to_tag.clear();
+        dialog.to_contact.clear();
+        dialog.caller_display.clear();
+        dialog.sdp.clear();
+        dialog.preemptive_auth = false;
+        dialog.auth_retried = false;
+        dialog.ack_sent = false;
+        dialog.cancel_requested = false;
+        dialog.started = m_clock.now();
+        dialog.cancel_after_ms = cancel_after_ms;
+    }
+
+    /**
+     * The INVITE dialog is finished and its slot is free again, the REGISTER binding stays valid
+     */
+    void end_call(Dialog& dialog)
+    {
+        dialog.to_tag.clear();
+        dialog.to_contact.clear();
+        dialog.cancel_requested = false;
+        setState(dialog, SipState::IDLE);
+    }
+
+    void notify(SipClientEvent event)
+    {
+        if (m_event_handler) {
+            m_event_handler(event);
+        }
+    }
+
+    void notify(SipClientEvent event, const Dialog& dialog)
+    {
+        event.call = call_of(dialog);
+        notify(event);
+    }
+
+    int8_t call_of(const Dialog& dialog) const
+    {
+        return &dialog - m_dialogs.data();
+    }
+
+    Dialog* find_dialog(SipState state)
+    {
+        for (Dialog& dialog : m_dialogs) {
+            if (dialog.state == state)
+                return &dialog;
+        }
+        return nullptr;
+    }
 
+    Dialog* find_dialog(std::string_view call_id)
+    {
+        for (Dialog& dialog : m_dialogs) {
+            if (dialog.state != SipState::IDLE && dialog.call_id.view() == call_id)
+                return &dialog;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Method of the request whose transaction timer the dialog runs
+     */
+    SipPacket::Method transaction_method(const Dialog& dialog) const
+    {
+        if (&dialog == &m_registration)
+            return SipPacket::Method::REGISTER;
+        switch (dialog.state) {
+        case SipState::CANCELLING:
+            return SipPacket::Method::CANCEL;
+        case SipState::BYE_SENT:
+            return SipPacket::Method::BYE;
+        default:
+            return SipPacket::Method::INVITE;
+        }
+    }
+
+    /**
+     * Dialog that acknowledged the final response of the INVITE with this CSeq,
+     * it may have ended already
+     */
+    Dialog* find_acked_dialog(std::string_view call_id, uint32_t cseq)
+    {
+        for (Dialog& dialog : m_dialogs) {
+            if (dialog.ack_sent && dialog.ack_cseq == cseq && dialog.call_id.view() == call_id)
+                return &dialog;
+        }
+        return nullptr;
+    }
+
+    void registered(const SipPacket& packet)
+    {
+        m_registration.cseq++;
+        m_registration.response[0] = '\0';
+
+        int32_t expires = packet.get_contact_expires();
+        if (expires <= 0)
+            expires = packet.get_expires();
+        if (expires <= 0)
+            expires = m_register_expires;
+        // refresh early enough that a refresh with all retransmissions completes in time
+        unsigned long expires_ms = (unsigned long)expires * 1000;
+        if (expires_ms > 2 * SipTransactionTimer::TIMEOUT)
+            m_register_refresh_ms = expires_ms - SipTransactionTimer::TIMEOUT;
+        else
+            m_register_refresh_ms = expires_ms / 2;
+        m_registered_since = m_clock.now();
+
+        logInfoP("REGISTER - OK :) expires in %d s", (int)expires);
+        setState(SipState::REGISTERED);
+    }
+
+    /**
+     * 423 Interval Too Brief, send the REGISTER again with the minimum the server accepts
+     */
+    void retry_register_with_min_expires(const SipPacket& packet)
+    {
+        int32_t min_expires = packet.get_min_expires();
+        if (min_expires <= (int32_t)m_register_expires) {
+            setState(SipState::ERROR, "INTERVAL_TOO_BRIEF_423 without usable Min-Expires");
+            return;
+        }
+        logInfoP("Registration interval raised to %d s", (int)min_expires);
+        m_register_expires = min_expires;
+        m_registration.cseq++;
+        m_registration.transaction.stop();
     }
 
     void send_sip_register()
     {
         TxBufferT& tx_buffer = m_socket.get_new_tx_buf();
-        std::string uri = "sip:" + m_server_ip;
 
-        send_sip_header("REGISTER", uri, "sip:" + m_user + "@" + m_server_ip, tx_buffer);
+        send_sip_header(SipPacket::Method::REGISTER, m_registration, m_register_uri, m_user_uri, tx_buffer);
 
-        tx_buffer << "Contact: \"" << m_user << "\" <sip:" << m_user << "@" << m_my_ip << ":" << LOCAL_PORT << ";transport=" << TRANSPORT_LOWER << ">\r\n";
+        tx_buffer << m_contact_line;
 
-        if (!m_response.empty()) {
-            tx_buffer << "Authorization: Digest username=\"" << m_user << "\", realm=\"" << m_realm << "\", nonce=\"" << m_nonce << "\", uri=\"" << uri << "\", algorithm=MD5, response=\"" << m_response << "\"\r\n";
-        }
-        tx_buffer << "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY, MESSAGE, SUBSCRIBE, INFO\r\n";
-        tx_buffer << "Expires: 3600\r\n";
+        append_authorization(m_register_uri, m_registration, tx_buffer);
+        tx_buffer << ALLOW_LINE;
+        tx_buffer << "Expires: " << m_register_expires << "\r\n";
         tx_buffer << "Content-Length: 0\r\n";
         tx_buffer << "\r\n";
 
         m_socket.send_buffered_data();
     }
 
-    void send_sip_invite()
+    void send_sip_invite(const Dialog& dialog)
     {
         TxBufferT& tx_buffer = m_socket.get_new_tx_buf();
 
-        send_sip_header("INVITE", m_uri, m_to_uri, tx_buffer);
+        send_sip_header(SipPacket::Method::INVITE, dialog, dialog.uri, dialog.to_uri, tx_buffer);
 
-        tx_buffer << "Contact: \"" << m_user << "\" <sip:" << m_user << "@" << m_my_ip << ":" << LOCAL_PORT << ";transport=" << TRANSPORT_LOWER << ">\r\n";
+        tx_buffer << m_contact_line;
 
-        if (!m_response.empty()) {
-            //tx_buffer << "Proxy-Authorization: Digest username=\"" << m_user << "\", realm=\"" << m_realm << "\", nonce=\"" << m_nonce << "\", uri=\"" << m_uri << "\", response=\"" << m_response << "\"\r\n";
-            tx_buffer << "Authorization: Digest username=\"" << m_user << "\", realm=\"" << m_realm << "\", nonce=\"" << m_nonce << "\", uri=\"" << m_uri << "\", response=\"" << m_response << "\"\r\n";
-        }
+        append_authorization(dialog.uri, dialog, tx_buffer);
         tx_buffer << "Content-Type: application/sdp\r\n";
-        tx_buffer << "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY, MESSAGE, SUBSCRIBE, INFO\r\n";
-        m_tx_sdp_buffer.clear();
-        m_tx_sdp_buffer << "v=0\r\n"
-                        << "o=" << m_user << " " << m_sdp_session_id << " " << m_sdp_session_id << " IN IP4 " << m_my_ip << "\r\n"
-                        << "s=sip-client/0.0.1\r\n"
-                        << "c=IN IP4 " << m_my_ip << "\r\n"
-                        << "t=0 0\r\n"
-                        // << "m=audio " << LOCAL_RTP_PORT << " RTP/AVP 0 8 101\r\n"
-                        << "m=audio " << LOCAL_RTP_PORT << " RTP/AVP 8 101\r\n"
-                        << "a=sendrecv\r\n"
-                        //<< "a=recvonly\r\n"
-                        << "a=rtpmap:101 telephone-event/8000\r\n"
-                        << "a=fmtp:101 0-15\r\n"
-                        << "a=ptime:20\r\n";
-
-        tx_buffer << "Content-Length: " << (uint32_t) m_tx_sdp_buffer.size() << "\r\n";
+        tx_buffer << ALLOW_LINE;
+        tx_buffer << "Content-Length: " << (uint32_t) dialog.sdp.size() << "\r\n";
         tx_buffer << "\r\n";
-        tx_buffer << m_tx_sdp_buffer.data();
+        tx_buffer << dialog.sdp;
 
         m_socket.send_buffered_data();
     }
@@ -593,16 +1108,16 @@ private:
      * * CSeq
      * * From tag value
      */
-    void send_sip_cancel()
+    void send_sip_cancel(const Dialog& dialog)
     {
         TxBufferT& tx_buffer = m_socket.get_new_tx_buf();
 
-        send_sip_header("CANCEL", m_uri, m_to_uri, tx_buffer);
+        send_sip_header(SipPacket::Method::CANCEL, dialog, dialog.uri, dialog.to_uri, tx_buffer);
 
-        if (!m_response.empty()) {
-            tx_buffer << "Contact: \"" << m_user << "\" <sip:" << m_user << "@" << m_my_ip << ":" << LOCAL_PORT << ";transport=" << TRANSPORT_LOWER << ">\r\n";
+        if (dialog.response[0] != '\0') {
+            tx_buffer << m_contact_line;
             tx_buffer << "Content-Type: application/sdp\r\n";
-            tx_buffer << "Authorization: Digest username=\"" << m_user << "\", realm=\"" << m_realm << "\", nonce=\"" << m_nonce << "\", uri=\"" << m_uri << "\", response=\"" << m_response << "\"\r\n";
+            append_authorization(dialog.uri, dialog, tx_buffer);
         }
         tx_buffer << "Content-Length: 0\r\n";
         tx_buffer << "\r\n";
@@ -617,19 +1132,16 @@ private:
      * * CSeq
      * * From tag value
      */
-    void send_sip_bye()
+    void send_sip_bye(const Dialog& dialog)
     {
         TxBufferT& tx_buffer = m_socket.get_new_tx_buf();
 
-        m_sip_sequence_number = 104;
-
-        send_sip_header("BYE", m_uri, m_to_uri, tx_buffer);
+        send_sip_header(SipPacket::Method::BYE, dialog, dialog.to_contact.empty() ? dialog.uri.view() : dialog.to_contact.view(), dialog.to_uri, tx_buffer);
 
-        if (!m_response.empty()) {
-            tx_buffer << "Contact: \"" << m_user << "\" <sip:" << m_user << "@" << m_my_ip << ":" << LOCAL_PORT << ";transport=" << TRANSPORT_LOWER << ">\r\n";
+        if (dialog.response[0] != '\0') {
+            tx_buffer << m_contact_line;
             tx_buffer << "Content-Type: application/sdp\r\n";
-            tx_buffer << "Max-Forwards: 70\r\n";
-            tx_buffer << "Authorization: Digest username=\"" << m_user << "\", realm=\"" << m_realm << "\", nonce=\"" << m_nonce << "\", uri=\"" << m_uri << "\", response=\"" << m_response << "\"\r\n";
+            append_authorization(dialog.uri, dialog, tx_buffer);
         }
         tx_buffer << "Content-Length: 0\r\n";
         tx_buffer << "\r\n";
@@ -637,11 +1149,28 @@ private:
         m_socket.send_buffered_data();
     }
 
-    void send_sip_ack()
+    /**
+     * ACK a final response of the INVITE
+     *
+     * \param[in] answered The ACK of a 2xx response is a new request to the remote target
+     */
+    void send_sip_ack(Dialog& dialog, bool answered = false)
+    {
+        dialog.ack_sent = true;
+        dialog.ack_answered = answered;
+        dialog.ack_cseq = dialog.cseq;
+        dialog.ack_branch = dialog.branch;
+        repeat_sip_ack(dialog);
+    }
+
+    /**
+     * Send the ACK of the last acknowledged INVITE, with its CSeq and branch
+     */
+    void repeat_sip_ack(const Dialog& dialog)
     {
         TxBufferT& tx_buffer = m_socket.get_new_tx_buf();
-        if (m_state == SipState::CALL_START) {
-            send_sip_header("ACK", m_to_contact, m_to_uri, tx_buffer);
+        if (dialog.ack_answered) {
+            send_sip_header(SipPacket::Method::ACK, dialog, dialog.to_contact, dialog.to_uri, tx_buffer);
             //std::string m_sdp_session_o;
             //std::string m_sdp_session_s;
             //std::string m_sdp_session_c;
@@ -660,7 +1189,7 @@ private:
             tx_buffer << "\r\n";
             //tx_buffer << m_tx_sdp_buffer.data();
         } else {
-            send_sip_header("ACK", m_uri, m_to_uri, tx_buffer);
+            send_sip_header(SipPacket::Method::ACK, dialog, dialog.uri, dialog.to_uri, tx_buffer);
             tx_buffer << "Content-Length: 0\r\n";
             tx_buffer << "\r\n";
         }
@@ -668,45 +1197,146 @@ private:
     }
 
     void send_sip_ok(const SipPacket& packet)
+    {
+        send_sip_reply("200 OK", packet);
+    }
+
+    /**
+     * \param[in] to_tag Local tag added to the To header of a dialog creating answer, 0 for none
+     */
+    void send_sip_reply(const char* code, const SipPacket& packet, uint32_t to_tag = 0)
     {
         TxBufferT& tx_buffer = m_socket.get_new_tx_buf();
 
-        send_sip_reply_header("200 OK", packet, tx_buffer);
+        send_sip_reply_header(code, packet, tx_buffer, to_tag);
         tx_buffer << "Content-Length: 0\r\n";
         tx_buffer << "\r\n";
 
         m_socket.send_buffered_data();
     }
 
-    void send_sip_header(const std::string& command, const std::string& uri, const std::string& to_uri, TxBufferT& stream)
+    void send_sip_header(SipPacket::Method method, const Dialog& dialog, std::string_view uri, std::string_view to_uri, TxBufferT& stream)
     {
+        const char* command = getMethodName(method);
         stream << command << " " << uri << " SIP/2.0\r\n";
 
-        stream << "CSeq: " << m_sip_sequence_number << " " << command << "\r\n";
-        stream << "Call-ID: " << m_call_id << "@" << m_my_ip << "\r\n";
-        stream << "Max-Forwards: 70\r\n";
-        stream << "User-Agent: sip-client/0.0.1\r\n";
-        if (command == "REGISTER") {
-            stream << "From: <sip:" << m_user << "@" << m_server_ip << ">;tag=" << m_tag << "\r\n";
-        } else if (command == "INVITE") {
-            stream << "From: \"" << m_caller_display << "\" <sip:" << m_user << "@" << m_server_ip << ">;tag=" << m_tag << "\r\n";
+        //an ACK belongs to its INVITE, the dialog may already be at a later request
+        bool ack = method == SipPacket::Method::ACK;
+        stream << "CSeq: " << (ack ? dialog.ack_cseq : dialog.cseq) << " " << command << "\r\n";
+        stream << "Call-ID: " << dialog.call_id << "\r\n";
+        stream << MAX_FORWARDS_USER_AGENT_LINES;
+        if (method == SipPacket::Method::REGISTER) {
+            stream << "From: ";
+        } else if (method == SipPacket::Method::INVITE) {
+            stream << "From: \"" << dialog.caller_display << "\" ";
         } else {
-            stream << "From: \"" << m_user << "\" <sip:" << m_user << "@" << m_server_ip << ">;tag=" << m_tag << "\r\n";
+            stream << "From: \"" << m_user << "\" ";
         }
-        stream << "Via: SIP/2.0/" << TRANSPORT_UPPER << " " << m_my_ip << ":" << LOCAL_PORT << ";branch=z9hG4bK-" << m_branch << ";rport\r\n";
+        stream << "<" << m_user_uri << ">;tag=" << dialog.tag << "\r\n";
+        stream << m_via_prefix << (ack ? dialog.ack_branch : dialog.branch) << ";rport\r\n";
 
-        if ((command == "ACK") && !m_to_tag.empty()) {
-            stream << "To: <" << to_uri << ">;tag=" << m_to_tag << "\r\n";
+        if ((method == SipPacket::Method::ACK || method == SipPacket::Method::BYE) && !dialog.to_tag.empty()) {
+            stream << "To: <" << to_uri << ">;tag=" << dialog.to_tag << "\r\n";
         } else {
             stream << "To: <" << to_uri << ">\r\n";
         }
     }
 
-    void send_sip_reply_header(const std::string& code, const SipPacket& packet, TxBufferT& stream)
+    /**
+     * Render the header fragments that only depend on user, server and local address
+     */
+    void render_fragments()
+    {
+        m_user_uri = "sip:";
+        m_user_uri += m_user;
+        m_user_uri += "@";
+        m_user_uri += m_server_ip;
+
+        m_via_prefix.clear();
+        m_via_prefix << "Via: SIP/2.0/" << TRANSPORT_UPPER << " " << m_my_ip << ":" << LOCAL_PORT << ";branch=z9hG4bK-";
+
+        m_contact_line.clear();
+        m_contact_line << "Contact: \"" << m_user << "\" <sip:" << m_user << "@" << m_my_ip << ":" << LOCAL_PORT << ";transport=" << TRANSPORT_LOWER << ">\r\n";
+
+        m_call_id_suffix.clear();
+        m_call_id_suffix << "@" << m_my_ip;
+
+        // all registrations and refreshes share one Call-ID (RFC 3261 10.2.4)
+        m_registration.call_id.clear();
+        m_registration.call_id << m_register_call_id << m_call_id_suffix;
+
+        //the SDP offer is joined from these and the session id by request_ring()
+        m_sdp_origin.clear();
+        m_sdp_origin << "v=0\r\n"
+                     << "o=" << m_user << " ";
+        m_sdp_tail.clear();
+        m_sdp_tail << " IN IP4 " << m_my_ip << "\r\n"
+                   << "s=sip-client/0.0.1\r\n"
+                   << "c=IN IP4 " << m_my_ip << "\r\n"
+                   << "t=0 0\r\n"
+                   // << "m=audio " << LOCAL_RTP_PORT << " RTP/AVP 0 8 101\r\n"
+                   << "m=audio " << LOCAL_RTP_PORT << " RTP/AVP 8 101\r\n"
+                   << "a=sendrecv\r\n"
+                   //<< "a=recvonly\r\n"
+                   << "a=rtpmap:101 telephone-event/8000\r\n"
+                   << "a=fmtp:101 0-15\r\n"
+                   << "a=ptime:20\r\n";
+
+        if (m_via_prefix.overflowed() || m_contact_line.overflowed() || m_call_id_suffix.overflowed() || m_sdp_origin.overflowed()
+            || m_sdp_tail.overflowed()) {
+            logErrorP("User or local address too long, requests will be malformed");
+        }
+    }
+
+    static const char* getMethodName(SipPacket::Method method)
+    {
+        switch (method)
+        {
+        case SipPacket::Method::REGISTER:
+            return "REGISTER";
+        case SipPacket::Method::INVITE:
+            return "INVITE";
+        case SipPacket::Method::ACK:
+            return "ACK";
+        case SipPacket::Method::CANCEL:
+            return "CANCEL";
+        case SipPacket::Method::BYE:
+            return "BYE";
+        case SipPacket::Method::NOTIFY:
+            return "NOTIFY";
+        case SipPacket::Method::INFO:
+            return "INFO";
+        default:
+            return "UNKNOWN";
+        }
+    }
+
+    /**
+     * Authorization header for the last response computed for the dialog, nothing if there is none
+     */
+    void append_authorization(std::string_view uri, const Dialog& dialog, TxBufferT& stream)
+    {
+        if (dialog.response[0] == '\0')
+            return;
+        const DigestChallenge& challenge = challenge_of(dialog);
+        stream << (challenge.proxy_auth ? "Proxy-Authorization" : "Authorization")
+               << ": Digest username=\"" << m_user << "\", realm=\"" << challenge.realm << "\", nonce=\"" << challenge.nonce
+               << "\", uri=\"" << uri << "\", algorithm=MD5, response=\"" << dialog.response << "\"";
+        if (!challenge.opaque.empty())
+            stream << ", opaque=\"" << challenge.opaque << "\"";
+        if (challenge.qop_auth)
+            stream << ", qop=auth, nc=" << dialog.nonce_count << ", cnonce=\"" << challenge.cnonce << "\"";
+        stream << "\r\n";
+    }
+
+    void send_sip_reply_header(const char* code, const SipPacket& packet, TxBufferT& stream, uint32_t to_tag = 0)
     {
         stream << "SIP/2.0 " << code << "\r\n";
 
-        stream << "To: " << packet.get_to() << "\r\n";
+        stream << "To: " << packet.get_to();
+        if (to_tag != 0 && packet.get_to_tag().empty())
+            stream << ";tag=" << to_tag;
+        stream << "\r\n";
         stream << "From: " << packet.get_from() << "\r\n";
         stream << "Via: " << packet.get_via() << "\r\n";
         stream << "CSeq: " << packet.get_cseq() << "\r\n";
@@ -714,70 +1344,119 @@ private:
         stream << "Max-Forwards: 70\r\n";
     }
 
-    bool read_param(const std::string& line, const std::string& param_name, std::string& output)
+    /**
+     * Keep the digest challenge of a 401 or 407, later requests of the same kind are
+     * authenticated with it until the server rejects the nonce
+     */
+    void store_challenge(const SipPacket& packet, DigestChallenge& challenge)
     {
-        std::string param(param_name + "=\"");
-        size_t pos = line.find(param);
-        if (pos == std::string::npos) {
-            return false;
+        if (challenge.nonce != packet.get_nonce()) {
+            challenge.nonce_count = 0;
+            to_hex(challenge.cnonce, (uint32_t)std::rand());
+        }
+        if (!challenge.nonce.assign(packet.get_nonce()) || !challenge.realm.assign(packet.get_realm()) || !challenge.opaque.assign(packet.get_opaque())) {
+            logErrorP("Digest challenge too long, the response will be rejected");
         }
-        pos += param.size();
-        size_t pos_end = line.find("\"", pos);
-        if (pos_end == std::string::npos) {
-            return false;
+        challenge.qop_auth = packet.is_qop_auth_offered();
+        challenge.proxy_auth = packet.get_status() == SipPacket::Status::PROXY_AUTH_REQ_407;
+        if (!packet.get_algorithm().empty() && packet.get_algorithm() != "MD5") {
+            logErrorP("Unsupported digest algorithm %.*s", (int)packet.get_algorithm().size(), packet.get_algorithm().data());
         }
-        output = line.substr(pos, pos_end - pos);
-        return true;
     }
 
-    void compute_auth_response(const std::string& method, const std::string& uri)
+    /**
+     * Digest response of RFC 2617, with qop=auth if the server offered it
+     *
+     * HA1 = MD5(user:realm:password) only changes with the realm, it is computed once
+     * and kept as raw bytes. Afterwards the password is not needed anymore.
+     * The response is kept in the dialog, a CANCEL repeats the one of its INVITE.
+     */
+    void compute_auth_response(const char* method, std::string_view uri, Dialog& dialog)
     {
-        std::string ha1_text;
-        std::string ha2_text;
         unsigned char hash[16];
-
-        m_response = "";
-        std::string data = m_user + ":" + m_realm + ":" + m_pwd;
+        char ha1_text[HEX_DIGEST_SIZE];
+        char ha2_text[HEX_DIGEST_SIZE];
+        DigestChallenge& challenge = challenge_of(dialog);
+
+        dialog.response[0] = '\0';
+        if (!m_ha1_valid || m_ha1_realm != challenge.realm) {
+            m_md5.start();
+            m_md5.update(m_user.data(), m_user.size());
+            m_md5.update(":", 1);
+            m_md5.update(challenge.realm.data(), challenge.realm.size());
+            m_md5.update(":", 1);
+            m_md5.update(m_pwd.data(), m_pwd.size());
+            m_md5.finish(m_ha1);
+            m_ha1_realm = challenge.realm;
+            m_ha1_valid = true;
+        }
+        to_hex(ha1_text, m_ha1, 16);
 
         m_md5.start();
-        m_md5.update(data);
+        m_md5.update(method);
+        m_md5.update(":", 1);
+        m_md5.update(uri.data(), uri.size());
         m_md5.finish(hash);
-        to_hex(ha1_text, hash, 16);
-
-        logTraceP("Calculating md5 for : %s", data.c_str());
-        logTraceP("Hex ha1 is %s", ha1_text.c_str());
+        to_hex(ha2_text, hash, 16);
 
-        data = method + ":" + uri;
+        logTraceP("Hex ha2 is %s", ha2_text);
 
         m_md5.start();
-        m_md5.update(data);
+        m_md5.update(ha1_text, HEX_DIGEST_SIZE - 1);
+        m_md5.update(":", 1);
+        m_md5.update(challenge.nonce.data(), challenge.nonce.size());
+        m_md5.update(":", 1);
+        if (challenge.qop_auth) {
+            to_hex(dialog.nonce_count, next_nonce_count(challenge));
+            m_md5.update(dialog.nonce_count);
+            m_md5.update(":", 1);
+            m_md5.update(challenge.cnonce);
+            m_md5.update(":auth:", 6);
+        }
+        m_md5.update(ha2_text, HEX_DIGEST_SIZE - 1);
         m_md5.finish(hash);
-        to_hex(ha2_text, hash, 16);
-
-        logTraceP("Calculating md5 for : %s", data.c_str());
-        logTraceP("Hex ha2 is %s", ha2_text.c_str());
+        to_hex(dialog.response, hash, 16);
 
-        data = ha1_text + ":" + m_nonce + ":" + ha2_text;
+        logTraceP("Hex response is %s", dialog.response);
+    }
 
-        m_md5.start();
-        m_md5.update(data);
-        m_md5.finish(hash);
-        to_hex(m_response, hash, 16);
+    /**
+     * Every request with the same nonce needs a higher nonce count. The INVITEs may still
+     * use the nonce of the REGISTER, then both count on from the higher one.
+     */
+    uint32_t next_nonce_count(DigestChallenge& challenge)
+    {
+        const DigestChallenge& other = &challenge == &m_register_auth ? m_invite_auth : m_register_auth;
+        if (other.nonce == challenge.nonce && other.nonce_count > challenge.nonce_count)
+            challenge.nonce_count = other.nonce_count;
+        return ++challenge.nonce_count;
+    }
 
-        logTraceP("Calculating md5 for : %s", data.c_str());
-        logTraceP("Hex response is %s", m_response.c_str());
+    DigestChallenge& challenge_of(const Dialog& dialog)
+    {
+        return &dialog == &m_registration ? m_register_auth : m_invite_auth;
     }
 
-    void to_hex(std::string& dest, const unsigned char* data, int len)
+    static void to_hex(char* dest, const unsigned char* data, int len)
     {
         static const char hexits[17] = "0123456789abcdef";
 
-        dest = "";
-        dest.reserve(len * 2 + 1);
         for (int i = 0; i < len; i++) {
-            dest.push_back(hexits[data[i] >> 4]);
-            dest.push_back(hexits[data[i] & 0x0F]);
+            *dest++ = hexits[data[i] >> 4];
+            *dest++ = hexits[data[i] & 0x0F];
         }
+        *dest = '\0';
+    }
+
+    static void to_hex(char* dest, uint32_t value)
+    {
+        static const char hexits[17] = "0123456789abcdef";
+
+        for (int i = 7; i >= 0; i--) {
+            dest[i] = hexits[value & 0x0F];
+            value >>= 4;
+        }
+        dest[8] = '\0';
     }
 
     const std::string& logPrefix()
@@ -794,11 +1473,11 @@ private:
         else
             logDebugP("State change from '%s' to '%s'", getStateName(m_state), getStateName(new_state));
         m_state = new_state;
-        m_lastSent = 0;
+        m_registration.transaction.stop();
         switch (new_state) {
         case SipState::ERROR:
             {
-                auto now = millis();
+                auto now = m_clock.now();
                 if (now == 0)
                     now = 1;
                 m_errorStarted = now;
@@ -815,6 +1494,19 @@ private:
         case SipState::REGISTER_UNAUTH:
             //dsp_wait_sip();
             break;
+        default:
+            break;
+        }
+    }
+
+    void setState(Dialog& dialog, SipState new_state)
+    {
+        if (new_state == dialog.state)
+            return;
+        logDebugP("Call %d state change from '%s' to '%s'", call_of(dialog), getStateName(dialog.state), getStateName(new_state));
+        dialog.state = new_state;
+        dialog.transaction.stop();
+        switch (new_state) {
         case SipState::CALL_IN_PROGRESS:
             //dsp_call();
             break;
@@ -827,51 +1519,57 @@ private:
     SipState m_state = SipState::IDLE;
 
     SocketT m_socket;
-    SocketT m_rtp_socket;
+    typename SocketT::template WithRing<RTP_QUEUE_SLOTS, RTP_SLOT_SIZE> m_rtp_socket;
     Md5T m_md5;
-    std::string m_server_ip;
+    SipHostT m_server_ip;
 
-    std::string m_user;
-    std::string m_pwd;
-    std::string m_my_ip;
+    SipUserT m_user;
+    SipPasswordT m_pwd;
+    SipHostT m_my_ip;
 
-    std::string m_uri;
-    std::string m_to_uri;
-    std::string m_to_contact;
-    std::string m_to_tag;
+    SipUriT m_register_uri;
+    SipUriT m_user_uri;
 
-    uint32_t m_sip_sequence_number;
-    uint32_t m_call_id;
+    Dialog m_registration;
+    uint32_t m_register_call_id;
+    uint32_t m_register_expires = DEFAULT_REGISTER_EXPIRES;
+    unsigned long m_register_refresh_ms = 0;
+    unsigned long m_registered_since = 0;
 
-    //auth stuff
-    std::string m_response;
-    std::string m_realm;
-    std::string m_nonce;
+    // fixed pool, a call never allocates a dialog
+    std::array<Dialog, SIP_MAX_DIALOGS> m_dialogs;
 
-    uint32_t m_tag;
-    uint32_t m_branch;
+    //auth stuff
+    // HA1 of m_ha1_realm, the password is kept to answer a challenge of another realm
+    unsigned char m_ha1[16];
+    SipRealmT m_ha1_realm;
+    bool m_ha1_valid = false;
+    // REGISTER and INVITE are challenged separately, e.g. 401 by the registrar and 407 by the proxy
+    DigestChallenge m_register_auth;
+    DigestChallenge m_invite_auth;
 
     //misc stuff
-    std::string m_caller_display;
-    std::string m_currentReceiveMessage;
-    unsigned long m_lastSent = 0;
-    unsigned long m_receivedStarted = 0;
+    ClockT m_clock;
     unsigned long m_errorStarted = 0;
 
-    uint32_t m_sdp_session_id;
-    Buffer<1024> m_tx_sdp_buffer;
+    //header fragments rendered by render_fragments()
+    Buffer<128> m_via_prefix;
+    Buffer<128> m_contact_line;
+    Buffer<64> m_call_id_suffix;
+    Buffer<96> m_sdp_origin;
+    Buffer<384> m_sdp_tail;
 
     std::function<void(const SipClientEvent&)> m_event_handler;
-    
-    volatile SipCommand m_sipCommand = SipCommand::SipCommandIdle;
 
     static constexpr const uint16_t LOCAL_PORT = 5060;
+    static constexpr const uint32_t DEFAULT_REGISTER_EXPIRES = 3600;
     static constexpr const char* TRANSPORT_LOWER = "udp";
     static constexpr const char* TRANSPORT_UPPER = "UDP";
+    static constexpr const char* ALLOW_LINE = "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY, MESSAGE, SUBSCRIBE, INFO\r\n";
+    static constexpr const char* MAX_FORWARDS_USER_AGENT_LINES = "Max-Forwards: 70\r\nUser-Agent: sip-client/0.0.1\r\n";
 
-    static constexpr uint32_t SOCKET_RX_TIMEOUT_MSEC = 200;
     static constexpr uint16_t LOCAL_RTP_PORT = 7078;
-    std::string rtp_port = "1234";
+    SipPortT rtp_port{ "1234" };
 };
 
 #ifdef USE_SML
@@ -906,7 +1604,7 @@ struct sip_states {
 };
 #endif //USE_SML
 
-template <class SocketT, class Md5T>
+template <class SocketT, class Md5T, class ClockT = SipMillisClock>
 class SipClient {
 public:
     SipClient(const std::string& user, const std::string& pwd, const std::string& server_ip, const std::string& server_port, const std::string& my_ip)
@@ -933,6 +1631,11 @@ public:
         return m_sip.is_initialized();
     }
 
+    void stop()
+    {
+        m_sip.stop();
+    }
+
     void set_server_ip(const std::string& server_ip)
     {
         m_sip.set_server_ip(server_ip);
@@ -953,15 +1656,34 @@ public:
         m_sip.set_event_handler(handler);
     }
 
+    ClockT& get_clock()
+    {
+        return m_sip.get_clock();
+    }
+
     /**
      * Initiate a call async
      *
      * \param[in] local_number A number that is registered locally on the server, e.g. "**610"
      * \param[in] caller_display This string is displayed on the caller's phone
+     * \return Handle of the call or -1 if it was not accepted
      */
-    void request_ring(const std::string& local_number, const std::string& caller_display)
+    int request_ring(const std::string& local_number, const std::string& caller_display)
     {
-        m_sip.request_ring(local_number, caller_display);
+        return m_sip.request_ring(local_number, caller_display);
+    }
+
+    /**
+     * Initiate a call async to a target that was prepared for the current server
+     *
+     * \param[in] target Rendered request URI of the number to call
+     * \param[in] caller_display This string is displayed on the caller's phone
+     * \param[in] cancel_after_ms The call is cancelled or hung up after this time, 0 to keep it
+     * \return Handle of the call or -1 if it was not accepted
+     */
+    int request_ring(const SipCallTarget& target, const char* caller_display, unsigned long cancel_after_ms = 0)
+    {
+        return m_sip.request_ring(target, caller_display, cancel_after_ms);
     }
 
     bool isConnected()
@@ -969,11 +1691,31 @@ public:
         return m_sip.isConnected();
     }
 
+    bool isReadyToCall()
+    {
+        return m_sip.isReadyToCall();
+    }
+
+    uint8_t get_active_calls() const
+    {
+        return m_sip.get_active_calls();
+    }
+
+    bool isCallActive(int call) const
+    {
+        return m_sip.isCallActive(call);
+    }
+
     void request_cancel()
     {
         m_sip.request_cancel();
     }
 
+    void request_cancel(int call)
+    {
+        m_sip.request_cancel(call);
+    }
+
     void run()
     {
 #ifdef USE_SML
@@ -985,9 +1727,9 @@ public:
     }
 
 private:
-    SipClientInt<SocketT, Md5T> m_sip;
+    SipClientInt<SocketT, Md5T, ClockT> m_sip;
 
 #ifdef USE_SML
-    sml::sm<sip_states<SipClientInt<SocketT, Md5T>>> m_sm;
+    sml::sm<sip_states<SipClientInt<SocketT, Md5T, ClockT>>> m_sm;
 #endif
 };
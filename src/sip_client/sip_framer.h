@@ -0,0 +1,112 @@
+#pragma once
+#include "sip_packet.h"
+#include <string_view>
+
+/**
+ * Splits received data into single SIP messages (RFC 3261 18.3)
+ *
+ * A message ends after the empty line terminating the header plus Content-Length bytes of body.
+ * On datagram transports a missing Content-Length means the body extends to the end of the datagram,
+ * on stream transports it means no body and an incomplete message stays in the input until more data arrives.
+ */
+class SipFramer
+{
+public:
+    SipFramer(const char* data, size_t length, bool stream = false)
+    : m_remaining(data, length)
+    , m_consumed(0)
+    , m_stream(stream)
+    {
+    }
+
+    /**
+     * Get the next complete message, returns false if no complete message is left
+     */
+    bool next(std::string_view& message)
+    {
+        skip_empty_lines();
+        if (m_remaining.empty())
+        {
+            return false;
+        }
+
+        size_t header_end = m_remaining.find(HEADER_END);
+        if (header_end == std::string_view::npos)
+        {
+            if (m_stream)
+            {
+                return false;
+            }
+            // let the parser report the broken datagram
+            return take(m_remaining.size(), message);
+        }
+        header_end += strlen(HEADER_END);
+
+        long content_length = -1;
+        std::string_view header = m_remaining.substr(0, header_end);
+        std::string_view line;
+        while (SipPacket::next_line(header, line))
+        {
+            size_t colon_pos = line.find(':');
+            if (colon_pos == std::string_view::npos)
+            {
+                continue;
+            }
+            if (SipPacket::lookup_header(SipPacket::trim(line.substr(0, colon_pos))) == SipPacket::Header::CONTENT_LENGTH)
+            {
+                content_length = SipPacket::to_number(line.substr(colon_pos + 1));
+                break;
+            }
+        }
+
+        size_t available_body = m_remaining.size() - header_end;
+        if (content_length < 0)
+        {
+            return take(m_stream ? header_end : m_remaining.size(), message);
+        }
+        if ((size_t)content_length > available_body)
+        {
+            if (m_stream)
+            {
+                return false;
+            }
+            // datagram shorter than announced, pass on what arrived
+            return take(m_remaining.size(), message);
+        }
+        return take(header_end + content_length, message);
+    }
+
+    /**
+     * Number of bytes that belong to messages returned by next() so far.
+     * Stream transports keep the data after this position for the next read.
+     */
+    size_t consumed() const
+    {
+        return m_consumed;
+    }
+
+private:
+    void skip_empty_lines()
+    {
+        // CRLF keep-alives between messages
+        while (m_remaining.size() >= SipPacket::LINE_ENDING_LEN && m_remaining.compare(0, SipPacket::LINE_ENDING_LEN, SipPacket::LINE_ENDING) == 0)
+        {
+            m_remaining.remove_prefix(SipPacket::LINE_ENDING_LEN);
+            m_consumed += SipPacket::LINE_ENDING_LEN;
+        }
+    }
+
+    bool take(size_t length, std::string_view& message)
+    {
+        message = m_remaining.substr(0, length);
+        m_remaining.remove_prefix(length);
+        m_consumed += length;
+        return true;
+    }
+
+    std::string_view m_remaining;
+    size_t m_consumed;
+    const bool m_stream;
+
+    static constexpr const char* HEADER_END = "\r\n\r\n";
+};
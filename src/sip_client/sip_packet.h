@@ -18,7 +18,9 @@
 #ifdef ARDUINO_ARCH_ESP32
 #include "esp_log.h"
 #endif
+#include <cstdint>
 #include <cstring>
+#include <string_view>
 //#include <iostream>
 
 class SipPacket
@@ -27,10 +29,12 @@ public:
 
     enum class Status {
         TRYING_100,
+        RINGING_180,
         SESSION_PROGRESS_183,
         OK_200,
         UNAUTHORIZED_401,
         PROXY_AUTH_REQ_407,
+        INTERVAL_TOO_BRIEF_423,
         BUSY_HERE_486,
         REQUEST_CANCELLED_487,
         SERVER_ERROR_500,
@@ -43,6 +47,9 @@ public:
         BYE,
         INFO,
         INVITE,
+        ACK,
+        CANCEL,
+        REGISTER,
         UNKNOWN
     };
 
@@ -56,11 +63,10 @@ public:
     : m_buffer(input_buffer)
     , m_buffer_length(input_buffer_length)
     , m_status(Status::UNKNOWN)
+    , m_status_code(0)
     , m_method(Method::UNKNOWN)
     , m_content_type(ContentType::UNKNOWN)
     , m_content_length(0)
-    , m_realm()
-    , m_nonce()
     {
     }
 
@@ -80,6 +86,34 @@ public:
         return m_status;
     }
 
+    uint16_t get_status_code() const
+    {
+        return m_status_code;
+    }
+
+    bool is_response() const
+    {
+        return m_status_code != 0;
+    }
+
+    bool is_provisional_response() const
+    {
+        return m_status_code >= 100 && m_status_code < 200;
+    }
+
+    bool is_final_response() const
+    {
+        return m_status_code >= 200;
+    }
+
+    /**
+     * 3xx-6xx, the request failed
+     */
+    bool is_error_response() const
+    {
+        return m_status_code >= 300;
+    }
+
     Method get_method() const
     {
         return m_method;
@@ -95,47 +129,134 @@ public:
 	return m_content_length;
     }
 
-    std::string get_nonce() const
+    std::string_view get_nonce() const
     {
         return m_nonce;
     }
 
-    std::string get_realm() const
+    std::string_view get_realm() const
     {
         return m_realm;
     }
 
-    std::string get_contact() const
+    std::string_view get_opaque() const
+    {
+        return m_opaque;
+    }
+
+    std::string_view get_algorithm() const
+    {
+        return m_algorithm;
+    }
+
+    /**
+     * The challenge offers qop=auth, the response must then contain nc and cnonce
+     */
+    bool is_qop_auth_offered() const
+    {
+        std::string_view options = m_qop;
+        while (!options.empty())
+        {
+            size_t comma = options.find(',');
+            if (equals_ignore_case(trim(options.substr(0, comma)), QOP_AUTH))
+            {
+                return true;
+            }
+            if (comma == std::string_view::npos)
+            {
+                break;
+            }
+            options.remove_prefix(comma + 1);
+        }
+        return false;
+    }
+
+    /**
+     * The nonce of the request was too old, but the credentials were valid
+     */
+    bool is_stale() const
+    {
+        return m_stale;
+    }
+
+    std::string_view get_contact() const
     {
         return m_contact;
     }
 
-    std::string get_to_tag() const
+    std::string_view get_to_tag() const
     {
         return m_to_tag;
     }
 
-    std::string get_cseq() const
+    /**
+     * URI of the From header, without display name and parameters
+     */
+    std::string_view get_from_uri() const
+    {
+        return m_from_uri;
+    }
+
+    std::string_view get_from_tag() const
+    {
+        return m_from_tag;
+    }
+
+    std::string_view get_cseq() const
     {
         return m_cseq;
     }
 
-    std::string get_call_id() const
+    uint32_t get_cseq_number() const
+    {
+        return m_cseq_number;
+    }
+
+    Method get_cseq_method() const
+    {
+        return m_cseq_method;
+    }
+
+    /**
+     * Value of the Expires header, -1 if not present
+     */
+    int32_t get_expires() const
+    {
+        return m_expires;
+    }
+
+    /**
+     * expires parameter of the Contact header, -1 if not present
+     */
+    int32_t get_contact_expires() const
+    {
+        return m_contact_expires;
+    }
+
+    /**
+     * Value of the Min-Expires header of a 423 response, -1 if not present
+     */
+    int32_t get_min_expires() const
+    {
+        return m_min_expires;
+    }
+
+    std::string_view get_call_id() const
     {
         return m_call_id;
     }
 
-    std::string get_to() const
+    std::string_view get_to() const
     {
         return m_to;
     }
 
-    std::string get_from() const
+    std::string_view get_from() const
     {
         return m_from;
     }
 
-    std::string get_via() const
+    std::string_view get_via() const
     {
         return m_via;
     }
@@ -149,111 +270,135 @@ public:
     {
         return m_dtmf_duration;
     }
-    std::string get_media() const
+    std::string_view get_media() const
     {
         return m_media;
     }
-    std::string get_cip() const
+    std::string_view get_cip() const
     {
         return m_cip;
     }
 
 private:
+    friend class SipFramer;
 
     bool parse_header()
     {
-        const char* start_position = m_buffer;
-        char* end_position = strstr(start_position, LINE_ENDING);
+        std::string_view remaining(m_buffer, m_buffer_length);
+        std::string_view line;
 
         m_method = Method::UNKNOWN;
         m_status = Status::UNKNOWN;
+        m_status_code = 0;
         m_content_type = ContentType::UNKNOWN;
         m_content_length = 0;
-        m_cseq = "";
-        m_call_id = "";
-        m_to = "";
-        m_from = "";
-        m_via = "";
+        m_cseq = {};
+        m_cseq_number = 0;
+        m_cseq_method = Method::UNKNOWN;
+        m_call_id = {};
+        m_to = {};
+        m_from = {};
+        m_via = {};
+        m_contact = {};
+        m_contact_expires = -1;
+        m_expires = -1;
+        m_min_expires = -1;
+        m_to_tag = {};
+        m_from_uri = {};
+        m_from_tag = {};
+        m_realm = {};
+        m_nonce = {};
+        m_qop = {};
+        m_opaque = {};
+        m_algorithm = {};
+        m_stale = false;
+        m_media = {};
+        m_cip = {};
         m_dtmf_signal = ' ';
         m_dtmf_duration = 0;
-        m_body = nullptr;
-
-        if (end_position == nullptr)
-        {
-#ifdef ARDUINO_ARCH_ESP32            
-            ESP_LOGW(TAG, "No line ending found in %s", m_buffer);
-#endif
-            return false;
-        }
+        m_body = {};
 
         uint32_t line_number = 0;
-        do
+        while (next_line(remaining, line))
         {
-            size_t length = end_position - start_position;
-            if (length == 0) //line only contains the line ending
+            if (line.empty()) //line only contains the line ending
             {
 #ifdef ARDUINO_ARCH_ESP32
                 ESP_LOGV(TAG, "Valid end of header detected");
 #endif
-                if (end_position + LINE_ENDING_LEN >= m_buffer + m_buffer_length)
-                {
-                    // no remaining data in buffer, so no body
-                    m_body = nullptr;
-                }
-                else
-                {
-                    m_body = end_position + LINE_ENDING_LEN;
-                }
+                // the remaining data is the body, if any
+                m_body = remaining;
                 return true;
             }
-            const char* next_start_position = end_position + LINE_ENDING_LEN;
             line_number++;
-
-            //create a proper null terminated c string
-            //from here on string functions may be used!
-            memset(end_position, 0, LINE_ENDING_LEN);
 #ifdef ARDUINO_ARCH_ESP32
-            ESP_LOGV(TAG, "Parsing line: %s", start_position);
+            ESP_LOGV(TAG, "Parsing line: %.*s", (int)line.size(), line.data());
 #endif
 
-            if (strstr(start_position, SIP_2_0_SPACE) == start_position)
+            if (line_number == 1)
             {
-                long code = strtol(start_position + strlen(SIP_2_0_SPACE), nullptr, 10);
+                if (starts_with(line, SIP_2_0_SPACE))
+                {
+                    long code = to_number(line.substr(strlen(SIP_2_0_SPACE)));
 #ifdef ARDUINO_ARCH_ESP32                
-                ESP_LOGV(TAG, "Detect status %ld", code);
+                    ESP_LOGV(TAG, "Detect status %ld", code);
 #endif
-                m_status = convert_status(code);
+                    m_status_code = (code < 0 || code > 699) ? 0 : code;
+                    m_status = convert_status(code);
+                }
+                else
+                {
+                    //first line, but no response
+                    m_method = convert_method(line);
+                }
+                continue;
+            }
+
+            size_t colon_pos = line.find(':');
+            if (colon_pos == std::string_view::npos)
+            {
+                continue;
             }
-            else if ((strncmp(WWW_AUTHENTICATE, start_position, strlen(WWW_AUTHENTICATE)) == 0)
-                    || (strncmp(PROXY_AUTHENTICATE, start_position, strlen(PROXY_AUTHENTICATE)) == 0))
+            std::string_view name = trim(line.substr(0, colon_pos));
+            std::string_view value = trim(line.substr(colon_pos + 1));
+
+            switch (lookup_header(name))
             {
+            case Header::WWW_AUTHENTICATE:
+            case Header::PROXY_AUTHENTICATE:
 #ifdef ARDUINO_ARCH_ESP32                
                 ESP_LOGV(TAG, "Detect authenticate line");
 #endif
-                //read realm and nonce from authentication line
-                if (!read_param(start_position, REALM, m_realm))
+                //read the digest challenge from authentication line
+                if (!read_param(value, REALM, m_realm))
                 {
 #ifdef ARDUINO_ARCH_ESP32
                     ESP_LOGW(TAG, "Failed to read realm in authenticate line");
 #endif
                 }
-                if (!read_param(start_position, NONCE, m_nonce))
+                if (!read_param(value, NONCE, m_nonce))
                 {
 #ifdef ARDUINO_ARCH_ESP32                    
                     ESP_LOGW(TAG, "Failed to read nonce in authenticate line");
 #endif
                 }
+                read_param(value, QOP, m_qop);
+                read_param(value, OPAQUE, m_opaque);
+                read_param(value, ALGORITHM, m_algorithm);
+                {
+                    std::string_view stale;
+                    m_stale = read_param(value, STALE, stale) && equals_ignore_case(stale, "true");
+                }
 #ifdef ARDUINO_ARCH_ESP32
-                ESP_LOGI(TAG, "Realm is %s and nonce is %s", m_realm.c_str(), m_nonce.c_str());
+                ESP_LOGI(TAG, "Realm is %.*s and nonce is %.*s", (int)m_realm.size(), m_realm.data(), (int)m_nonce.size(), m_nonce.data());
 #endif
-            }
-            else if (strncmp(CONTACT, start_position, strlen(CONTACT)) == 0)
-            {
+                break;
+            case Header::CONTACT:
 #ifdef ARDUINO_ARCH_ESP32
                 ESP_LOGV(TAG, "Detect contact line");
 #endif
-                const char* last_pos = strstr(start_position, ">");
-                if (last_pos == nullptr)
+                m_contact = read_uri(value);
+                if (m_contact.empty())
                 {
 #ifdef ARDUINO_ARCH_ESP32
                     ESP_LOGW(TAG, "Failed to read content of contact line");
@@ -261,112 +406,118 @@ private:
                 }
                 else
                 {
-                    m_contact = std::string(start_position + strlen(CONTACT), last_pos);
+                    size_t params_pos = value.find('>');
+                    size_t expires_pos = value.find(EXPIRES_PARAM, params_pos == std::string_view::npos ? 0 : params_pos);
+                    if (expires_pos != std::string_view::npos)
+                    {
+                        m_contact_expires = to_number(value.substr(expires_pos + strlen(EXPIRES_PARAM)));
+                    }
                 }
-            }
-            else if (strncmp(TO, start_position, strlen(TO)) == 0)
-            {
+                break;
+            case Header::EXPIRES:
+                m_expires = to_number(value);
+                break;
+            case Header::MIN_EXPIRES:
+                m_min_expires = to_number(value);
+                break;
+            case Header::TO:
 #ifdef ARDUINO_ARCH_ESP32
                 ESP_LOGV(TAG, "Detect to line");
 #endif
-                const char* tag_pos = strstr(start_position, ">;tag=");
-                if (tag_pos != nullptr)
+                m_to = value;
+                m_to_tag = read_tag(value);
+                break;
+            case Header::FROM:
+                m_from = value;
+                m_from_uri = read_uri(value);
+                m_from_tag = read_tag(value);
+                break;
+            case Header::VIA:
+                m_via = value;
+                break;
+            case Header::C_SEQ:
                 {
-                    m_to_tag = std::string(tag_pos + strlen(">;tag="));
+                    m_cseq = value;
+                    long cseq_number = to_number(m_cseq);
+                    m_cseq_number = cseq_number < 0 ? 0 : cseq_number;
+                    size_t method_pos = m_cseq.find(' ');
+                    if (method_pos != std::string_view::npos)
+                    {
+                        m_cseq_method = convert_method(trim(m_cseq.substr(method_pos)));
+                    }
                 }
-                m_to = std::string(start_position + strlen(TO));
-            }
-            else if (strstr(start_position, FROM) == start_position)
-            {
-                m_from = std::string(start_position + strlen(FROM));
-            }
-            else if (strstr(start_position, VIA) == start_position)
-            {
-                m_via = std::string(start_position + strlen(VIA));
-            }
-            else if (strstr(start_position, C_SEQ) == start_position)
-            {
-                m_cseq = std::string(start_position + strlen(C_SEQ));
-            }
-            else if (strstr(start_position, CALL_ID) == start_position)
-            {
-                m_call_id = std::string(start_position + strlen(CALL_ID));
-            }
-            else if (strstr(start_position, CONTENT_TYPE) == start_position)
-            {
-                m_content_type = convert_content_type(start_position + strlen(CONTENT_TYPE));
-            }
-            else if (strstr(start_position, CONTENT_LENGTH) == start_position)
-            {
-                long length = strtol(start_position + strlen(CONTENT_LENGTH), nullptr, 10);
-                if (length < 0)
+                break;
+            case Header::CALL_ID:
+                m_call_id = value;
+                break;
+            case Header::CONTENT_TYPE:
+                m_content_type = convert_content_type(value);
+                break;
+            case Header::CONTENT_LENGTH:
                 {
+                    long length = to_number(value);
+                    if (length < 0)
+                    {
 #ifdef ARDUINO_ARCH_ESP32
-                    ESP_LOGW(TAG, "Invalid content length %ld", length);
+                        ESP_LOGW(TAG, "Invalid content length %ld", length);
 #endif
+                    }
+                    else
+                    {
+                        m_content_length = length;
+                    }
                 }
-                else
-                {
-                    m_content_length = length;
-                }
-            }
-
-            else if (line_number == 1)
-            {
-                //first line, but no response
-                m_method = convert_method(start_position);
+                break;
+            case Header::UNKNOWN:
+                break;
             }
-
-            //go to next line
-            start_position = next_start_position;
-            end_position = strstr(start_position, LINE_ENDING);
-        } while(end_position);
+        }
 
         //no line only containing the line ending found :(
+#ifdef ARDUINO_ARCH_ESP32
+        if (line_number == 0)
+            ESP_LOGW(TAG, "No line ending found in %.*s", (int)m_buffer_length, m_buffer);
+#endif
         return false;
     }
 
     bool parse_body()
     {
-        if (m_body == nullptr)
+        if (m_body.empty())
         {
             return true;
         }
 
-        const char* start_position = m_body;
-        char* end_position = strstr(start_position, LINE_ENDING);
+        std::string_view remaining = m_body;
+        std::string_view line;
 
-        if (end_position == nullptr)
+        if (!next_line(remaining, line))
         {
 #ifdef ARDUINO_ARCH_ESP32
-            ESP_LOGW(TAG, "No line ending found in %s", m_body);
+            ESP_LOGW(TAG, "No line ending found in %.*s", (int)m_body.size(), m_body.data());
 #endif
             return false;
         }
 
         do
         {
-            size_t length = end_position - start_position;
-            if (length == 0) //line only contains the line ending
+            if (line.empty()) //line only contains the line ending
             {
                 return true;
             }
-
-            const char* next_start_position = end_position + LINE_ENDING_LEN;
-
-            //create a proper null terminated c string
-            //from here on string functions may be used!
-            memset(end_position, 0, LINE_ENDING_LEN);
 #ifdef ARDUINO_ARCH_ESP32
-            ESP_LOGV(TAG, "Parsing line: %s", start_position);
+            ESP_LOGV(TAG, "Parsing line: %.*s", (int)line.size(), line.data());
 #endif
-            if (strstr(start_position, SIGNAL) == start_position)
+            if (starts_with(line, SIGNAL))
             {
-                m_dtmf_signal = *(start_position + strlen(SIGNAL));
+                if (line.size() > strlen(SIGNAL))
+                {
+                    m_dtmf_signal = line[strlen(SIGNAL)];
+                }
             }
-            else if (strstr(start_position, DURATION) == start_position)
+            else if (starts_with(line, DURATION))
             {
-                long duration = strtol(start_position + strlen(DURATION), nullptr, 10);
+                long duration = to_number(line.substr(strlen(DURATION)));
                 if (duration < 0)
                 {
 #ifdef ARDUINO_ARCH_ESP32
@@ -378,48 +529,240 @@ private:
                     m_dtmf_duration = duration;
                 }
             }
-            else if (strstr(start_position, MEDIA) == start_position)
+            else if (starts_with(line, MEDIA))
             {
-                m_media = std::string(start_position + strlen(MEDIA));
+                m_media = line.substr(strlen(MEDIA));
             }
-            else if (strstr(start_position, CIP) == start_position)
+            else if (starts_with(line, CIP))
             {
-                m_cip = std::string(start_position + strlen(CIP));
+                m_cip = line.substr(strlen(CIP));
             }
-
-            //go to next line
-            start_position = next_start_position;
-            end_position = strstr(start_position, LINE_ENDING);
-        } while(end_position);
+        } while (next_line(remaining, line));
 
         return true;
     }
 
-    bool read_param(const char* line, const char* param_name, std::string& output)
+    /**
+     * Split the next CRLF terminated line off the front of remaining.
+     * The line ending is not part of line. Returns false if there is no complete line left.
+     */
+    static bool next_line(std::string_view& remaining, std::string_view& line)
     {
-        const char* pos = strstr(line, param_name);
-        if (pos == nullptr)
+        size_t end_position = remaining.find(LINE_ENDING);
+        if (end_position == std::string_view::npos)
         {
             return false;
         }
-        if (*(pos + strlen(param_name)) != '=')
+        line = remaining.substr(0, end_position);
+        remaining.remove_prefix(end_position + LINE_ENDING_LEN);
+        return true;
+    }
+
+    static bool starts_with(std::string_view text, const char* prefix)
+    {
+        size_t length = strlen(prefix);
+        return text.size() >= length && memcmp(text.data(), prefix, length) == 0;
+    }
+
+    enum class Header : uint8_t {
+        UNKNOWN,
+        VIA,
+        FROM,
+        TO,
+        CALL_ID,
+        C_SEQ,
+        CONTACT,
+        CONTENT_TYPE,
+        CONTENT_LENGTH,
+        EXPIRES,
+        MIN_EXPIRES,
+        WWW_AUTHENTICATE,
+        PROXY_AUTHENTICATE,
+    };
+
+    static constexpr char to_lower(char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+
+    /**
+     * Length, first and last character of a header name, folded to lower case.
+     * Distinct for all header names the parser knows, so it can be used as switch label.
+     */
+    static constexpr uint32_t header_key(std::string_view name)
+    {
+        return name.empty() ? 0 : ((uint32_t)name.size() << 16) | ((uint32_t)to_lower(name.front()) << 8) | (uint32_t)to_lower(name.back());
+    }
+
+    static bool equals_ignore_case(std::string_view text, std::string_view other)
+    {
+        if (text.size() != other.size())
         {
             return false;
         }
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            if (to_lower(text[i]) != to_lower(other[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static Header match_header(std::string_view name, std::string_view header_name, Header header)
+    {
+        return equals_ignore_case(name, header_name) ? header : Header::UNKNOWN;
+    }
 
-        if (*(pos + strlen(param_name) + 1) != '"')
+    /**
+     * Resolve a header name in O(1), case-insensitive and including the RFC 3261 compact forms
+     */
+    static Header lookup_header(std::string_view name)
+    {
+        switch (header_key(name))
         {
-            return false;
+        // compact forms, the key is unique for single characters
+        case header_key("v"): return Header::VIA;
+        case header_key("f"): return Header::FROM;
+        case header_key("t"): return Header::TO;
+        case header_key("i"): return Header::CALL_ID;
+        case header_key("m"): return Header::CONTACT;
+        case header_key("c"): return Header::CONTENT_TYPE;
+        case header_key("l"): return Header::CONTENT_LENGTH;
+
+        case header_key("Via"): return match_header(name, "Via", Header::VIA);
+        case header_key("From"): return match_header(name, "From", Header::FROM);
+        case header_key("To"): return match_header(name, "To", Header::TO);
+        case header_key("Call-ID"): return match_header(name, "Call-ID", Header::CALL_ID);
+        case header_key("CSeq"): return match_header(name, "CSeq", Header::C_SEQ);
+        case header_key("Contact"): return match_header(name, "Contact", Header::CONTACT);
+        case header_key("Content-Type"): return match_header(name, "Content-Type", Header::CONTENT_TYPE);
+        case header_key("Content-Length"): return match_header(name, "Content-Length", Header::CONTENT_LENGTH);
+        case header_key("Expires"): return match_header(name, "Expires", Header::EXPIRES);
+        case header_key("Min-Expires"): return match_header(name, "Min-Expires", Header::MIN_EXPIRES);
+        case header_key("WWW-Authenticate"): return match_header(name, "WWW-Authenticate", Header::WWW_AUTHENTICATE);
+        case header_key("Proxy-Authenticate"): return match_header(name, "Proxy-Authenticate", Header::PROXY_AUTHENTICATE);
         }
+        return Header::UNKNOWN;
+    }
 
-        pos += strlen(param_name) + 2;
-        const char* pos_end = strchr(pos, '"');
-        if (pos_end == nullptr)
+    static std::string_view trim(std::string_view text)
+    {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+        {
+            text.remove_prefix(1);
+        }
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t'))
+        {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    /**
+     * URI of a name-addr ("name" <uri>;params) or addr-spec (uri;params) value
+     */
+    static std::string_view read_uri(std::string_view value)
+    {
+        size_t start_pos = value.find('<');
+        if (start_pos == std::string_view::npos)
+        {
+            return value.substr(0, value.find(';'));
+        }
+        size_t end_pos = value.find('>', start_pos);
+        if (end_pos == std::string_view::npos)
+        {
+            return std::string_view();
+        }
+        return value.substr(start_pos + 1, end_pos - start_pos - 1);
+    }
+
+    /**
+     * tag parameter of a To or From value, the parameters start after the URI
+     */
+    static std::string_view read_tag(std::string_view value)
+    {
+        size_t params_pos = value.find('>');
+        if (params_pos == std::string_view::npos)
+        {
+            params_pos = 0;
+        }
+        size_t tag_pos = value.find(";tag=", params_pos);
+        if (tag_pos == std::string_view::npos)
+        {
+            return std::string_view();
+        }
+        std::string_view tag = value.substr(tag_pos + strlen(";tag="));
+        return tag.substr(0, tag.find(';'));
+    }
+
+    /**
+     * Bounded replacement for strtol: leading spaces, an optional sign and decimal digits
+     */
+    static long to_number(std::string_view text)
+    {
+        size_t pos = 0;
+        while (pos < text.size() && text[pos] == ' ')
+        {
+            pos++;
+        }
+        bool negative = pos < text.size() && text[pos] == '-';
+        if (negative)
+        {
+            pos++;
+        }
+        unsigned long value = 0;
+        while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9')
+        {
+            value = value * 10 + (text[pos] - '0');
+            pos++;
+        }
+        return negative ? -(long)value : (long)value;
+    }
+
+    /**
+     * Read the value of an auth-param, either quoted or a token (RFC 2617 1.2).
+     * The name must start a parameter, so "nonce" does not match "cnonce".
+     */
+    static bool read_param(std::string_view line, const char* param_name, std::string_view& output)
+    {
+        const size_t name_length = strlen(param_name);
+        size_t pos = line.find(param_name);
+        while (pos != std::string_view::npos && pos > 0 && line[pos - 1] != ' ' && line[pos - 1] != ',' && line[pos - 1] != '\t')
+        {
+            pos = line.find(param_name, pos + name_length);
+        }
+        if (pos == std::string_view::npos)
         {
             return false;
         }
-        output = std::string(pos, pos_end);
-        return true;
+        pos += name_length;
+        if (pos + 1 >= line.size() || line[pos] != '=')
+        {
+            return false;
+        }
+        pos++;
+
+        if (line[pos] == '"')
+        {
+            pos++;
+            size_t pos_end = line.find('"', pos);
+            if (pos_end == std::string_view::npos)
+            {
+                return false;
+            }
+            output = line.substr(pos, pos_end - pos);
+            return true;
+        }
+
+        size_t pos_end = line.find_first_of(", \t", pos);
+        if (pos_end == std::string_view::npos)
+        {
+            pos_end = line.size();
+        }
+        output = line.substr(pos, pos_end - pos);
+        return !output.empty();
     }
 
     Status convert_status(uint32_t code) const
@@ -429,40 +772,58 @@ private:
         case 200: return Status::OK_200;
         case 401: return Status::UNAUTHORIZED_401;
         case 100: return Status::TRYING_100;
+        case 180: return Status::RINGING_180;
         case 183: return Status::SESSION_PROGRESS_183;
         case 500: return Status::SERVER_ERROR_500;
         case 486: return Status::BUSY_HERE_486;
         case 487: return Status::REQUEST_CANCELLED_487;
         case 407: return Status::PROXY_AUTH_REQ_407;
+        case 423: return Status::INTERVAL_TOO_BRIEF_423;
         case 603: return Status::DECLINE_603;
         }
         return Status::UNKNOWN;
     }
 
-    Method convert_method(const char* input) const
+    /**
+     * Method token at the start of a request line or the method of a CSeq value
+     */
+    Method convert_method(std::string_view input) const
     {
-        if (strstr(input, NOTIFY) == input)
+        std::string_view token = input.substr(0, input.find(' '));
+        if (token == NOTIFY)
         {
             return Method::NOTIFY;
         }
-        if (strstr(input, BYE) == input)
+        if (token == BYE)
         {
             return Method::BYE;
         }
-        if (strstr(input, INFO) == input)
+        if (token == INFO)
         {
             return Method::INFO;
         }
-        if (strstr(input, INVITE) == input)
+        if (token == INVITE)
         {
             return Method::INVITE;
         }
+        if (token == ACK)
+        {
+            return Method::ACK;
+        }
+        if (token == CANCEL)
+        {
+            return Method::CANCEL;
+        }
+        if (token == REGISTER)
+        {
+            return Method::REGISTER;
+        }
         return Method::UNKNOWN;
     }
 
-    ContentType convert_content_type(const char* input) const
+    ContentType convert_content_type(std::string_view input) const
     {
-	if (strstr(input, APPLICATION_DTMF_RELAY) == input)
+	if (starts_with(input, APPLICATION_DTMF_RELAY))
 	{
 	    return ContentType::APPLICATION_DTMF_RELAY;
 	}
@@ -473,25 +834,39 @@ private:
     const size_t m_buffer_length;
 
     Status m_status;
+    uint16_t m_status_code;
     Method m_method;
     ContentType m_content_type;
     uint32_t m_content_length;
 
-    std::string m_media;
-    std::string m_cip;
-
-    std::string m_realm;
-    std::string m_nonce;
-    std::string m_contact;
-    std::string m_to_tag;
-    std::string m_cseq;
-    std::string m_call_id;
-    std::string m_to;
-    std::string m_from;
-    std::string m_via;
+    // all views point into the parsed buffer, which must outlive the packet.
+    // The buffer is never modified and does not need to be null terminated.
+    std::string_view m_media;
+    std::string_view m_cip;
+
+    std::string_view m_realm;
+    std::string_view m_nonce;
+    std::string_view m_qop;
+    std::string_view m_opaque;
+    std::string_view m_algorithm;
+    bool m_stale;
+    std::string_view m_contact;
+    int32_t m_contact_expires;
+    int32_t m_expires;
+    int32_t m_min_expires;
+    std::string_view m_to_tag;
+    std::string_view m_from_uri;
+    std::string_view m_from_tag;
+    std::string_view m_cseq;
+    uint32_t m_cseq_number;
+    Method m_cseq_method;
+    std::string_view m_call_id;
+    std::string_view m_to;
+    std::string_view m_from;
+    std::string_view m_via;
     char m_dtmf_signal;
     uint16_t m_dtmf_duration;
-    const char* m_body;
+    std::string_view m_body;
 
     static constexpr const char* LINE_ENDING = "\r\n";
     static constexpr size_t LINE_ENDING_LEN = 2;
@@ -499,22 +874,21 @@ private:
 
     static constexpr const char* TAG = "SipPacket";
     static constexpr const char* SIP_2_0_SPACE = "SIP/2.0 ";
-    static constexpr const char* WWW_AUTHENTICATE = "WWW-Authenticate";
-    static constexpr const char* PROXY_AUTHENTICATE = "Proxy-Authenticate";
-    static constexpr const char* CONTACT = "Contact: <";
-    static constexpr const char* TO = "To: ";
-    static constexpr const char* FROM = "From: ";
-    static constexpr const char* VIA = "Via: ";
-    static constexpr const char* C_SEQ = "CSeq: ";
-    static constexpr const char* CALL_ID = "Call-ID: ";
-    static constexpr const char* CONTENT_TYPE = "Content-Type: ";
-    static constexpr const char* CONTENT_LENGTH = "Content-Length: ";
     static constexpr const char* REALM = "realm";
     static constexpr const char* NONCE = "nonce";
-    static constexpr const char* NOTIFY = "NOTIFY ";
-    static constexpr const char* BYE = "BYE ";
-    static constexpr const char* INFO = "INFO ";
-    static constexpr const char* INVITE = "INVITE ";
+    static constexpr const char* QOP = "qop";
+    static constexpr const char* QOP_AUTH = "auth";
+    static constexpr const char* OPAQUE = "opaque";
+    static constexpr const char* ALGORITHM = "algorithm";
+    static constexpr const char* STALE = "stale";
+    static constexpr const char* EXPIRES_PARAM = ";expires=";
+    static constexpr const char* NOTIFY = "NOTIFY";
+    static constexpr const char* BYE = "BYE";
+    static constexpr const char* INFO = "INFO";
+    static constexpr const char* INVITE = "INVITE";
+    static constexpr const char* ACK = "ACK";
+    static constexpr const char* CANCEL = "CANCEL";
+    static constexpr const char* REGISTER = "REGISTER";
     static constexpr const char* APPLICATION_DTMF_RELAY = "application/dtmf-relay";
     static constexpr const char* SIGNAL = "Signal=";
     static constexpr const char* DURATION = "Duration=";
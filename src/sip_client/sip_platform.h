@@ -0,0 +1,121 @@
+#pragma once
+
+#ifdef ARDUINO
+#include "OpenKNX.h"
+#else
+// Minimal replacement of the Arduino and OpenKNX functions used by the SIP client,
+// so it can be built and run natively on Linux
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#ifndef SIP_LOG_LEVEL
+// 0 error, 1 info, 2 debug, 3 trace
+#define SIP_LOG_LEVEL 1
+#endif
+
+inline unsigned long millis()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return (unsigned long) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline void sip_platform_log(const std::string& prefix, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    printf("%s: ", prefix.c_str());
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+}
+
+#define logErrorP(...) sip_platform_log(logPrefix(), __VA_ARGS__)
+#define logInfoP(...) do { if (SIP_LOG_LEVEL >= 1) sip_platform_log(logPrefix(), __VA_ARGS__); } while (0)
+#define logDebugP(...) do { if (SIP_LOG_LEVEL >= 2) sip_platform_log(logPrefix(), __VA_ARGS__); } while (0)
+#define logTraceP(...) do { if (SIP_LOG_LEVEL >= 3) sip_platform_log(logPrefix(), __VA_ARGS__); } while (0)
+
+class IPAddress
+{
+public:
+    IPAddress(uint32_t address = 0)
+    : m_address(address)
+    {
+    }
+
+    IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth)
+    : m_address(first | (second << 8) | (third << 16) | ((uint32_t) fourth << 24))
+    {
+    }
+
+    bool fromString(const char* address)
+    {
+        unsigned bytes[4];
+        char rest;
+        if (sscanf(address, "%u.%u.%u.%u%c", &bytes[0], &bytes[1], &bytes[2], &bytes[3], &rest) != 4)
+            return false;
+        for (unsigned byte : bytes)
+        {
+            if (byte > 255)
+                return false;
+        }
+        m_address = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
+        return true;
+    }
+
+    std::string toString() const
+    {
+        char buffer[16];
+        snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", m_address & 0xFF, (m_address >> 8) & 0xFF, (m_address >> 16) & 0xFF, m_address >> 24);
+        return buffer;
+    }
+
+    // network byte order, as lwIP and Arduino
+    operator uint32_t() const
+    {
+        return m_address;
+    }
+
+private:
+    uint32_t m_address;
+};
+#endif
+
+/**
+ * Time source of the SIP client, a simulation can replace it by a virtual clock
+ */
+struct SipMillisClock
+{
+    unsigned long now() const
+    {
+        return millis();
+    }
+};
+
+/**
+ * Clock of the SIP client as seen by its sockets, received datagrams are stamped with it
+ * so the time they wait in the queue is measured on the client's time base.
+ * Reads millis() until set() was called.
+ */
+class SipClockRef
+{
+public:
+    template <class ClockT>
+    void set(const ClockT& clock)
+    {
+        m_clock = &clock;
+        m_now = [](const void* clock) { return static_cast<const ClockT*>(clock)->now(); };
+    }
+
+    unsigned long now() const
+    {
+        return m_now != nullptr ? m_now(m_clock) : millis();
+    }
+
+private:
+    const void* m_clock = nullptr;
+    unsigned long (*m_now)(const void*) = nullptr;
+};
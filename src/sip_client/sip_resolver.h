@@ -0,0 +1,174 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "fixed_string.h"
+#include "lwip/dns.h"
+#include "lwip/ip_addr.h"
+#ifdef ARDUINO_ARCH_ESP32
+#include "lwip/tcpip.h"
+#endif
+
+#ifndef SIP_DNS_CACHE_TTL_MS
+#define SIP_DNS_CACHE_TTL_MS 300000
+#endif
+#ifndef SIP_DNS_NEGATIVE_TTL_MS
+#define SIP_DNS_NEGATIVE_TTL_MS 30000
+#endif
+
+/**
+ * Cached, non-blocking resolution of the server host name
+ *
+ * The lookup runs in lwIP, resolve() only reports the state and never waits.
+ * Addresses are kept for SIP_DNS_CACHE_TTL_MS, failures for SIP_DNS_NEGATIVE_TTL_MS.
+ * lwIP does not pass the record TTL to the callback, so a fixed lifetime is used.
+ * Once an address is known it is returned while a refresh is pending or has
+ * failed, only the very first lookup makes the caller wait.
+ *
+ * A lookup can not be cancelled, so its result is written to static storage and
+ * matched by a generation number. Only one lookup is in flight at a time,
+ * a newer one supersedes the older one.
+ */
+class SipResolver
+{
+public:
+    enum class Result {
+        RESOLVED,
+        PENDING,
+        FAILED,
+    };
+
+    void set_host(std::string_view host)
+    {
+        m_host = host;
+        m_state = State::IDLE;
+        m_has_address = false;
+    }
+
+    /**
+     * \param[out] address The address of the host if RESOLVED is returned
+     */
+    Result resolve(unsigned long now, uint32_t& address)
+    {
+        if (m_state == State::PENDING)
+        {
+            if (s_lookup.generation == m_generation && s_lookup.state != State::PENDING)
+            {
+                take_result();
+                m_resolved_at = now;
+            }
+            else if (s_lookup.generation != m_generation)
+            {
+                // superseded by another lookup, start again
+                m_state = State::IDLE;
+            }
+        }
+        else if (m_state != State::IDLE && now - m_resolved_at >= (m_state == State::RESOLVED ? SIP_DNS_CACHE_TTL_MS : SIP_DNS_NEGATIVE_TTL_MS))
+        {
+            m_state = State::IDLE;
+        }
+
+        if (m_state == State::IDLE)
+        {
+            start_lookup();
+            if (m_state != State::PENDING)
+            {
+                m_resolved_at = now;
+            }
+        }
+
+        if (m_has_address)
+        {
+            // a stale address is better than dropping the message
+            address = m_address;
+            return Result::RESOLVED;
+        }
+        return m_state == State::PENDING ? Result::PENDING : Result::FAILED;
+    }
+
+private:
+    enum class State : uint8_t {
+        IDLE,
+        PENDING,
+        RESOLVED,
+        FAILED,
+    };
+
+    struct Lookup
+    {
+        volatile uint32_t generation;
+        volatile State state;
+        volatile uint32_t address;
+        char host[DNS_MAX_NAME_LENGTH];
+    };
+
+    void start_lookup()
+    {
+        m_generation = ++s_generation;
+        s_lookup.generation = m_generation;
+        s_lookup.state = State::PENDING;
+        strncpy(s_lookup.host, m_host.c_str(), sizeof(s_lookup.host) - 1);
+        s_lookup.host[sizeof(s_lookup.host) - 1] = '\0';
+        m_state = State::PENDING;
+#ifdef ARDUINO_ARCH_ESP32
+        // lwIP must only be called from its own task
+        if (tcpip_callback(lookup, (void*) (uintptr_t) m_generation) != ERR_OK)
+        {
+            s_lookup.state = State::FAILED;
+        }
+#else
+        lookup((void*) (uintptr_t) m_generation);
+#endif
+        if (s_lookup.state != State::PENDING)
+        {
+            take_result();
+        }
+    }
+
+    void take_result()
+    {
+        m_state = s_lookup.state;
+        if (m_state == State::RESOLVED)
+        {
+            m_address = s_lookup.address;
+            m_has_address = true;
+        }
+    }
+
+    static void lookup(void* arg)
+    {
+        ip_addr_t addr;
+        err_t err = dns_gethostbyname(s_lookup.host, &addr, found, arg);
+        if (err == ERR_OK)
+            found(s_lookup.host, &addr, arg);
+        else if (err != ERR_INPROGRESS)
+            found(s_lookup.host, nullptr, arg);
+    }
+
+    static void found(const char* name, const ip_addr_t* addr, void* arg)
+    {
+        (void) name;
+        if ((uint32_t) (uintptr_t) arg != s_lookup.generation)
+            return;
+        if (addr != nullptr && IP_IS_V4(addr))
+        {
+            s_lookup.address = ip4_addr_get_u32(ip_2_ip4(addr));
+            s_lookup.state = State::RESOLVED;
+        }
+        else
+        {
+            s_lookup.state = State::FAILED;
+        }
+    }
+
+    SipHostT m_host;
+    State m_state = State::IDLE;
+    uint32_t m_generation = 0;
+    uint32_t m_address = 0;
+    bool m_has_address = false;
+    unsigned long m_resolved_at = 0;
+
+    static inline Lookup s_lookup = {};
+    static inline uint32_t s_generation = 0;
+};
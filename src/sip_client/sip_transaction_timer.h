@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * Retransmission and timeout timers of a SIP client transaction over UDP (RFC 3261 17.1)
+ *
+ * INVITE transactions use Timer A/B, all other requests Timer E/F.
+ * The request is retransmitted after T1 and the interval doubles on every
+ * retransmission, capped at T2 for non-INVITE requests. If no final response
+ * arrives within 64*T1 the transaction times out.
+ */
+class SipTransactionTimer
+{
+public:
+    static constexpr unsigned long T1 = 500;
+    static constexpr unsigned long T2 = 4000;
+    static constexpr unsigned long TIMEOUT = 64 * T1;
+
+    /**
+     * Start a new transaction, the request must have been sent right before
+     */
+    void start(unsigned long now, bool invite)
+    {
+        m_state = State::CALLING;
+        m_invite = invite;
+        m_started = now;
+        m_lastSent = now;
+        m_interval = T1;
+    }
+
+    void stop()
+    {
+        m_state = State::IDLE;
+    }
+
+    /**
+     * A provisional response was received.
+     * INVITE transactions stop retransmitting and wait without timeout for the final response,
+     * non-INVITE transactions continue to retransmit in T2 intervals.
+     */
+    void provisional()
+    {
+        if (m_state != State::CALLING)
+            return;
+        if (m_invite)
+            m_state = State::PROCEEDING;
+        else
+            m_interval = T2;
+    }
+
+    /**
+     * Stop retransmitting, but still time out if no final response arrives within 64*T1 from now.
+     * Used after a CANCEL was answered while the 487 of the INVITE is outstanding.
+     */
+    void wait(unsigned long now)
+    {
+        m_state = State::WAITING;
+        m_started = now;
+    }
+
+    bool is_active() const
+    {
+        return m_state != State::IDLE;
+    }
+
+    bool is_timed_out(unsigned long now) const
+    {
+        return (m_state == State::CALLING || m_state == State::WAITING) && now - m_started >= TIMEOUT;
+    }
+
+    /**
+     * Returns true if the request must be retransmitted now and schedules the next retransmission
+     */
+    bool retransmit_due(unsigned long now)
+    {
+        if (m_state != State::CALLING)
+            return false;
+        if (now - m_lastSent < m_interval)
+            return false;
+        m_lastSent = now;
+        m_interval *= 2;
+        if (!m_invite && m_interval > T2)
+            m_interval = T2;
+        return true;
+    }
+
+private:
+    enum class State {
+        IDLE,
+        CALLING,
+        PROCEEDING,
+        WAITING,
+    };
+
+    State m_state = State::IDLE;
+    bool m_invite = false;
+    unsigned long m_started = 0;
+    unsigned long m_lastSent = 0;
+    unsigned long m_interval = T1;
+};
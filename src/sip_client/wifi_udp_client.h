@@ -18,100 +18,63 @@
 #include "OpenKNX.h"
 #include <array>
 #include <string>
+#include <string_view>
 #include <cstring>
+#include <algorithm>
 
-#include "WiFiUdp.h"
-
-static constexpr const int RX_BUFFER_SIZE = 2048;
-static constexpr const int TX_BUFFER_SIZE = 2048;
+#include "buffer.h"
+#include "datagram_ring.h"
+#include "fixed_string.h"
+#include "sip_platform.h"
+#include "sip_resolver.h"
 
+#ifdef ARDUINO_ARCH_ESP32
+#include "AsyncUDP.h"
+#else
+#include "WiFiUdp.h"
+#endif
 
-template<std::size_t SIZE>
-class Buffer
+/**
+ * UDP transport over the WiFi stack of the Arduino core
+ *
+ * Received datagrams wait in a ring of RX_SLOTS slots of RX_SIZE bytes.
+ */
+template <size_t RX_SLOTS = RX_QUEUE_SLOTS, size_t RX_SIZE = RX_SLOT_SIZE>
+class WifiUdpClientT
 {
 public:
-    Buffer()
-    {
-        clear();
-    }
-
-    void clear()
-    {
-        m_buffer[0] = '\0';
-    }
+    using RingT = DatagramRing<RX_SLOTS, RX_SIZE>;
+    using DatagramT = typename RingT::Slot;
+    // the same transport with another receive ring
+    template <size_t SLOTS, size_t SIZE>
+    using WithRing = WifiUdpClientT<SLOTS, SIZE>;
 
-    Buffer<SIZE>& operator<<(const char* str)
-    {
-        strncat(m_buffer.data(), str, m_buffer.size() - strlen(m_buffer.data()) - 1);
-        return *this;
-    }
-    Buffer<SIZE>& operator<<(const std::string& str)
-    {
-        strncat(m_buffer.data(), str.c_str(), m_buffer.size() - strlen(m_buffer.data()) - 1);
-        return *this;
-    }
-    Buffer<SIZE>& operator<<(int8_t i)
-    {
-        snprintf(m_buffer.data() + strlen(m_buffer.data()), m_buffer.size() - strlen(m_buffer.data()), "%c", i);
-        return *this;
-    }
-    Buffer<SIZE>& operator<<(uint8_t i)
-    {
-        snprintf(m_buffer.data() + strlen(m_buffer.data()), m_buffer.size() - strlen(m_buffer.data()), "%c", i);
-        return *this;
-    }
-    Buffer<SIZE>& operator<<(uint16_t i)
-    {
-        snprintf(m_buffer.data() + strlen(m_buffer.data()), m_buffer.size() - strlen(m_buffer.data()), "%d", i);
-        return *this;
-    }
-    Buffer<SIZE>& operator<<(uint32_t i)
-    {
-        snprintf(m_buffer.data() + strlen(m_buffer.data()), m_buffer.size() - strlen(m_buffer.data()), "%d", i);
-        return *this;
-    }
-
-    const char* data() const
-    {
-        return m_buffer.data();
-    }
-
-    size_t size() const
-    {
-        return strlen(m_buffer.data());
-    }
-
-private:
-    std::array<char, SIZE> m_buffer;
-};
-
-using TxBufferT = Buffer<TX_BUFFER_SIZE>;
-
-class WifiUdpClient
-{
-public:
-    WifiUdpClient(const std::string& server, const std::string& server_port, uint16_t local_port)
+    WifiUdpClientT(const std::string& server, const std::string& server_port, uint16_t local_port)
     : m_server_port(atoi(server_port.c_str()))
     , m_server(server)
     , m_local_port(local_port)
+#ifndef ARDUINO_ARCH_ESP32
     , m_wifiUdp()
+#endif
     , m_initialized(false)
     , m_logPrefix("SIP UDP")
     {
         m_useIp = m_server_ip.fromString(m_server.c_str());
+        if (!m_useIp)
+            m_resolver.set_host(m_server);
     }
 
-    ~WifiUdpClient()
+    ~WifiUdpClientT()
     {
     }
 
-    const std::string logPrefix()
+    const std::string& logPrefix()
     {
         return m_logPrefix;
     }
 
 
-    void set_server_ip(const std::string& server)
+    void set_server_ip(std::string_view server)
     {
         if (is_initialized())
         {
@@ -119,14 +82,27 @@ public:
         }
         m_server = server;
         m_useIp = m_server_ip.fromString(m_server.c_str());
+        if (!m_useIp)
+            m_resolver.set_host(m_server);
     }
-    void set_server_port(const std::string& server_port)
+    void set_server_port(std::string_view server_port)
     {
         if (is_initialized())
         {
             deinit();
         }
-        m_server_port = atoi(server_port.c_str());
+        // null terminated copy for atoi
+        SipPortT port(server_port);
+        m_server_port = atoi(port.c_str());
+    }
+
+    /**
+     * Clock that received datagrams are stamped with
+     */
+    template <class ClockT>
+    void set_clock(const ClockT& clock)
+    {
+        m_clock.set(clock);
     }
 
     void deinit()
@@ -135,7 +111,11 @@ public:
         {
             return;
         }
+#ifdef ARDUINO_ARCH_ESP32
+        m_asyncUdp.close();
+#else
         m_wifiUdp.stop();
+#endif
         m_initialized = false;
     }
 
@@ -147,8 +127,20 @@ public:
             return false;
         }
     
+#ifdef ARDUINO_ARCH_ESP32
+        // packets are queued by the AsyncUDP task as they arrive, the loop does not need to poll the socket
+        m_asyncUdp.onPacket([this](AsyncUDPPacket& packet) { on_packet(packet); });
+        m_initialized = m_asyncUdp.listen(m_local_port);
+#else
         auto result = m_wifiUdp.begin(m_local_port);
         m_initialized = result != 0;
+#endif
+        if (m_initialized && !m_useIp)
+        {
+            // start the lookup, so the address is known when the first request is sent
+            uint32_t address;
+            m_resolver.resolve(millis(), address);
+        }
         return m_initialized;
     }
 
@@ -158,18 +150,57 @@ public:
     }
 
 
-    std::string receive(uint32_t timeout_msec)
+    /**
+     * A datagram is waiting, receive() will return it
+     */
+    bool has_pending()
+    {
+#ifndef ARDUINO_ARCH_ESP32
+        poll();
+#endif
+        return m_rx_ring.has_pending();
+    }
+
+    /**
+     * Take the next received datagram, nullptr if none is waiting.
+     * The datagram stays valid until the next call of receive().
+     */
+    const DatagramT* receive()
     {
-        m_wifiUdp.setTimeout(timeout_msec);
-        auto size = m_wifiUdp.parsePacket();
-        if (size)
+#ifndef ARDUINO_ARCH_ESP32
+        poll();
+#endif
+        uint32_t dropped = m_rx_ring.get_dropped();
+        if (dropped != m_rx_dropped_reported)
         {
+            logErrorP("Dropped %u datagrams (%u oldest, %u newest, %u too large)", (unsigned) (dropped - m_rx_dropped_reported),
+                (unsigned) m_rx_ring.get_dropped_oldest(), (unsigned) m_rx_ring.get_dropped_newest(), (unsigned) m_rx_ring.get_dropped_oversize());
+            m_rx_dropped_reported = dropped;
+        }
+        const DatagramT* datagram = m_rx_ring.receive();
+        if (datagram != nullptr)
+        {
+            logTraceP("Received %d bytes", (int) datagram->length);
+        }
+        return datagram;
+    }
 
-            auto result = m_wifiUdp.readString();
-            logTraceP("Received %d bytes",size);
-            return std::string(result.c_str());
+    /**
+     * The datagram with this remote address was sent by the server
+     */
+    bool is_server_address(uint32_t address)
+    {
+        if (m_useIp)
+        {
+            return address == (uint32_t) m_server_ip;
         }
-        return std::string();
+        uint32_t server_address;
+        return m_resolver.resolve(millis(), server_address) == SipResolver::Result::RESOLVED && address == server_address;
+    }
+
+    const RingT& get_rx_ring() const
+    {
+        return m_rx_ring;
     }
 
     TxBufferT& get_new_tx_buf()
@@ -180,15 +211,40 @@ public:
 
     bool send_buffered_data()
     { 
+        if (m_tx_buffer.overflowed())
+        {
+            logErrorP("Message does not fit into %d bytes, not sent", (int) TX_BUFFER_SIZE);
+            return false;
+        }
         logDebugP("Sending %d bytes", m_tx_buffer.size());
         // logDebugP("Sending following data: %s", m_tx_buffer.data());
-        if (m_useIp)
-            m_wifiUdp.beginPacket(m_server_ip, m_server_port);
-        else
-            m_wifiUdp.beginPacket(m_server.c_str(), m_server_port);
+        IPAddress server_ip = m_server_ip;
+        if (!m_useIp)
+        {
+            // only the first lookup drops messages, requests are retransmitted by their transaction
+            uint32_t address;
+            switch (m_resolver.resolve(millis(), address))
+            {
+            case SipResolver::Result::RESOLVED:
+                server_ip = IPAddress(address);
+                break;
+            case SipResolver::Result::PENDING:
+                logDebugP("Resolving %s, message not sent", m_server.c_str());
+                return false;
+            default:
+                logErrorP("Failed to resolve %s", m_server.c_str());
+                return false;
+            }
+        }
+#ifdef ARDUINO_ARCH_ESP32
+        auto result = m_asyncUdp.writeTo((const uint8_t*) m_tx_buffer.data(), m_tx_buffer.size(), server_ip, m_server_port);
+        bool endPacketResult = true;
+#else
+        m_wifiUdp.beginPacket(server_ip, m_server_port);
 
         auto result = m_wifiUdp.write((const uint8_t*) m_tx_buffer.data(), m_tx_buffer.size());
         bool endPacketResult = m_wifiUdp.endPacket();
+#endif
         if (result != m_tx_buffer.size() || endPacketResult == 0)
         {         
             logErrorP("Failed to send data %d, errno=%d", result, errno);
@@ -196,15 +252,61 @@ public:
         return result == m_tx_buffer.size() && endPacketResult != 0;
     }
 private:
+#ifdef ARDUINO_ARCH_ESP32
+    /**
+     * Called by the AsyncUDP task, the only producer of the queue
+     */
+    void on_packet(AsyncUDPPacket& packet)
+    {
+        m_rx_ring.push((const char*) packet.data(), packet.length(), (uint32_t) packet.remoteIP(), packet.remotePort(), m_clock.now());
+    }
+#else
+    /**
+     * Move the datagrams queued by the core into the ring, bounded per call
+     */
+    void poll()
+    {
+        // datagrams that do not fit stay in the socket until the next poll
+        for (size_t i = 0; i < RX_SLOTS && m_rx_ring.has_free_slot(); i++)
+        {
+            auto size = m_wifiUdp.parsePacket();
+            if (size <= 0)
+            {
+                return;
+            }
+            auto slot = m_rx_ring.reserve(size);
+            if (slot == nullptr)
+            {
+                continue;
+            }
+            auto length = m_wifiUdp.read((uint8_t*) slot->data.data(), slot->data.size());
+            slot->length = length > 0 ? length : 0;
+            slot->remote_ip = (uint32_t) m_wifiUdp.remoteIP();
+            slot->remote_port = m_wifiUdp.remotePort();
+            slot->received_at = m_clock.now();
+            m_rx_ring.commit();
+        }
+    }
+#endif
+
     uint16_t m_server_port;
     IPAddress m_server_ip;
     bool m_useIp;
-    std::string m_server;
+    SipHostT m_server;
     const uint16_t m_local_port;
     bool m_initialized;
     std::string m_logPrefix;
+    SipClockRef m_clock;
 
     TxBufferT m_tx_buffer;
-    std::array<char, RX_BUFFER_SIZE> m_rx_buffer;
+    SipResolver m_resolver;
+    RingT m_rx_ring;
+    uint32_t m_rx_dropped_reported = 0;
+#ifdef ARDUINO_ARCH_ESP32
+    AsyncUDP m_asyncUdp;
+#else
     WiFiUDP m_wifiUdp;
+#endif
 };
+
+using WifiUdpClient = WifiUdpClientT<>;
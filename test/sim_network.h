@@ -0,0 +1,394 @@
+#pragma once
+#include "sip_client/sip_platform.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "sip_client/buffer.h"
+#include "sip_client/datagram_ring.h"
+
+/**
+ * Deterministic random numbers for the emulated network (xorshift32)
+ */
+class SimRandom
+{
+public:
+    explicit SimRandom(uint32_t seed = 1)
+    : m_state(seed != 0 ? seed : 1)
+    {
+    }
+
+    uint32_t next()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return m_state;
+    }
+
+    /**
+     * True with the given probability in [0, 1]
+     */
+    bool chance(double probability)
+    {
+        return probability > 0 && next() < probability * 4294967296.0;
+    }
+
+    /**
+     * Uniform in [0, limit]
+     */
+    unsigned long up_to(unsigned long limit)
+    {
+        return limit == 0 ? 0 : next() % (limit + 1);
+    }
+
+private:
+    uint32_t m_state;
+};
+
+/**
+ * One direction of an emulated datagram link
+ *
+ * Datagrams are copied into fixed slots and delivered once their due time on the
+ * virtual clock is reached. Loss, duplication, reordering and delay are drawn per
+ * datagram, a link that is down loses everything. Nothing is allocated, a full
+ * channel drops the datagram like a full socket buffer does.
+ */
+template <size_t SLOTS = 32, size_t SLOT_SIZE = 1472>
+class SimChannel
+{
+public:
+    struct Config
+    {
+        double loss = 0;
+        double duplicate = 0;
+        // the datagram is held back by reorder_ms, later ones overtake it
+        double reorder = 0;
+        unsigned long reorder_ms = 30;
+        unsigned long delay_ms = 1;
+        unsigned long jitter_ms = 0;
+        bool down = false;
+    };
+
+    struct Stats
+    {
+        uint32_t sent = 0;
+        uint64_t sent_bytes = 0;
+        uint32_t delivered = 0;
+        uint32_t lost = 0;
+        uint32_t duplicated = 0;
+        uint32_t reordered = 0;
+        uint32_t overflowed = 0;
+    };
+
+    struct Datagram
+    {
+        size_t length;
+        unsigned long due;
+        uint32_t sequence;
+        std::array<char, SLOT_SIZE> data;
+
+        std::string_view view() const
+        {
+            return std::string_view(data.data(), length);
+        }
+    };
+
+    explicit SimChannel(uint32_t seed)
+    : m_random(seed)
+    {
+    }
+
+    void send(const char* data, size_t length, unsigned long now)
+    {
+        m_stats.sent++;
+        m_stats.sent_bytes += length;
+        if (config.down || m_random.chance(config.loss))
+        {
+            m_stats.lost++;
+            return;
+        }
+        queue(data, length, now);
+        if (m_random.chance(config.duplicate))
+        {
+            m_stats.duplicated++;
+            queue(data, length, now);
+        }
+    }
+
+    /**
+     * The next datagram that is due, nullptr if none is.
+     * It stays valid until the next call of take().
+     */
+    const Datagram* take(unsigned long now)
+    {
+        if (m_taken >= 0)
+        {
+            m_used[m_taken] = false;
+            m_taken = -1;
+        }
+        int found = -1;
+        for (size_t i = 0; i < SLOTS; i++)
+        {
+            if (!m_used[i] || (long) (now - m_slots[i].due) < 0)
+                continue;
+            if (found < 0 || (long) (m_slots[i].due - m_slots[found].due) < 0 || (m_slots[i].due == m_slots[found].due && (int32_t) (m_slots[i].sequence - m_slots[found].sequence) < 0))
+                found = i;
+        }
+        if (found < 0)
+            return nullptr;
+        m_taken = found;
+        m_stats.delivered++;
+        return &m_slots[found];
+    }
+
+    /**
+     * Forget everything in flight, e.g. when the link goes down
+     */
+    void flush()
+    {
+        m_used = {};
+        m_taken = -1;
+    }
+
+    const Stats& stats() const
+    {
+        return m_stats;
+    }
+
+    Config config;
+
+private:
+    void queue(const char* data, size_t length, unsigned long now)
+    {
+        int index = -1;
+        for (size_t i = 0; i < SLOTS; i++)
+        {
+            if (!m_used[i] && (int) i != m_taken)
+            {
+                index = i;
+                break;
+            }
+        }
+        if (index < 0 || length > SLOT_SIZE)
+        {
+            m_stats.overflowed++;
+            return;
+        }
+        auto& slot = m_slots[index];
+        memcpy(slot.data.data(), data, length);
+        slot.length = length;
+        slot.sequence = m_next_sequence++;
+        slot.due = now + config.delay_ms + m_random.up_to(config.jitter_ms);
+        if (m_random.chance(config.reorder))
+        {
+            m_stats.reordered++;
+            slot.due += config.reorder_ms;
+        }
+        m_used[index] = true;
+    }
+
+    SimRandom m_random;
+    std::array<Datagram, SLOTS> m_slots;
+    std::array<bool, SLOTS> m_used = {};
+    int m_taken = -1;
+    uint32_t m_next_sequence = 0;
+    Stats m_stats;
+};
+
+/**
+ * Virtual clock and both directions of the link between the client and the server stand-in
+ *
+ * The sockets and the clock of the client find the network through SimNetwork::current,
+ * the client constructs them itself.
+ */
+class SimNetwork
+{
+public:
+    using ChannelT = SimChannel<>;
+
+    // 192.168.1.1 in network byte order as IPAddress stores it
+    static constexpr uint32_t SERVER_IP = 0x0101a8c0;
+    static constexpr uint16_t SIP_PORT = 5060;
+
+    explicit SimNetwork(uint32_t seed = 1, unsigned long start = 1000)
+    : now(start)
+    , to_server(seed)
+    , to_client(seed * 7919 + 1)
+    {
+        current = this;
+    }
+
+    ~SimNetwork()
+    {
+        if (current == this)
+            current = nullptr;
+    }
+
+    /**
+     * Same impairment in both directions
+     */
+    void configure(const ChannelT::Config& config)
+    {
+        to_server.config = config;
+        to_client.config = config;
+    }
+
+    void set_down(bool down)
+    {
+        to_server.config.down = down;
+        to_client.config.down = down;
+        if (down)
+        {
+            to_server.flush();
+            to_client.flush();
+        }
+    }
+
+    /**
+     * Deliver the requests that are due to the stand-in and send its responses that are due
+     */
+    template <class ServerT>
+    void exchange(ServerT& server)
+    {
+        while (auto datagram = to_server.take(now))
+            server.receive(datagram->view(), now);
+        while (server.poll(now, m_response))
+            to_client.send(m_response.data(), m_response.size(), now);
+    }
+
+    unsigned long now;
+    ChannelT to_server;
+    ChannelT to_client;
+
+    static inline SimNetwork* current = nullptr;
+
+private:
+    std::string m_response;
+};
+
+/**
+ * Virtual time source of the client, see SipMillisClock
+ */
+struct SimClock
+{
+    unsigned long now() const
+    {
+        return SimNetwork::current->now;
+    }
+};
+
+/**
+ * Transport of the client on the emulated network with the interface of PosixUdpClientT
+ *
+ * Only the socket bound to the SIP port is connected, the RTP socket sends into the void.
+ */
+template <size_t RX_SLOTS = RX_QUEUE_SLOTS, size_t RX_SIZE = RX_SLOT_SIZE>
+class SimUdpClientT
+{
+public:
+    using RingT = DatagramRing<RX_SLOTS, RX_SIZE>;
+    using DatagramT = typename RingT::Slot;
+    // the same transport with another receive ring
+    template <size_t SLOTS, size_t SIZE>
+    using WithRing = SimUdpClientT<SLOTS, SIZE>;
+
+    SimUdpClientT(const std::string&, const std::string&, uint16_t local_port)
+    : m_connected(local_port == SimNetwork::SIP_PORT)
+    {
+    }
+
+    void set_server_ip(std::string_view)
+    {
+    }
+
+    void set_server_port(std::string_view)
+    {
+    }
+
+    template <class ClockT>
+    void set_clock(const ClockT& clock)
+    {
+        m_clock.set(clock);
+    }
+
+    bool init()
+    {
+        if (m_initialized)
+            return false;
+        m_initialized = true;
+        return true;
+    }
+
+    void deinit()
+    {
+        m_initialized = false;
+    }
+
+    bool is_initialized() const
+    {
+        return m_initialized;
+    }
+
+    bool has_pending()
+    {
+        poll();
+        return m_rx_ring.has_pending();
+    }
+
+    const DatagramT* receive()
+    {
+        poll();
+        return m_rx_ring.receive();
+    }
+
+    bool is_server_address(uint32_t address) const
+    {
+        return address == SimNetwork::SERVER_IP;
+    }
+
+    TxBufferT& get_new_tx_buf()
+    {
+        m_tx_buffer.clear();
+        return m_tx_buffer;
+    }
+
+    bool send_buffered_data()
+    {
+        if (m_tx_buffer.overflowed() || !m_initialized)
+            return false;
+        if (m_connected)
+        {
+            auto network = SimNetwork::current;
+            network->to_server.send(m_tx_buffer.data(), m_tx_buffer.size(), network->now);
+        }
+        return true;
+    }
+
+private:
+    void poll()
+    {
+        if (!m_initialized || !m_connected)
+            return;
+        auto network = SimNetwork::current;
+        while (m_rx_ring.has_free_slot())
+        {
+            auto datagram = network->to_client.take(network->now);
+            if (datagram == nullptr)
+                return;
+            m_rx_ring.push(datagram->data.data(), datagram->length, SimNetwork::SERVER_IP, SimNetwork::SIP_PORT, m_clock.now());
+        }
+    }
+
+    const bool m_connected;
+    bool m_initialized = false;
+    SipClockRef m_clock;
+    TxBufferT m_tx_buffer;
+    RingT m_rx_ring;
+};
+
+using SimUdpClient = SimUdpClientT<>;
@@ -0,0 +1,579 @@
+#pragma once
+#include "sip_client/md5_l.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <string>
+#include <string_view>
+
+/**
+ * Scriptable registrar and PBX stand-in for the host tests
+ *
+ * It answers REGISTER, INVITE, ACK, CANCEL and BYE of one client the way a FRITZ!Box does:
+ * digest challenges, 100/180/183, the final response of the callee after configurable delays
+ * and injected failures. Requests are passed to receive(), responses are taken with poll()
+ * once they are due, so the same stand-in runs behind a UDP socket on localhost or behind
+ * an emulated channel with a virtual clock.
+ *
+ * A retransmitted request gets the last response of its transaction again, final responses
+ * to an INVITE are repeated with Timer G until the ACK arrives (RFC 3261 17.2.1).
+ */
+class SipServerStandIn
+{
+public:
+    enum class Challenge {
+        NONE,
+        WWW_AUTHENTICATE_401,
+        PROXY_AUTHENTICATE_407,
+    };
+
+    // what the callee does once the phone rings
+    enum class Callee {
+        KEEP_RINGING,
+        ANSWER,
+        BUSY_486,
+        DECLINE_603,
+    };
+
+    struct Config
+    {
+        std::string user = "620";
+        std::string password = "secret";
+        std::string realm = "fritz.box";
+        Challenge register_challenge = Challenge::WWW_AUTHENTICATE_401;
+        Challenge invite_challenge = Challenge::WWW_AUTHENTICATE_401;
+        bool qop = false;
+        // every new call is challenged with a fresh nonce, the old one is reported as stale
+        bool new_nonce_per_call = false;
+        uint32_t expires = 3600;
+        // REGISTER with a shorter Expires is answered with 423
+        uint32_t min_expires = 0;
+        // 100 Trying and 180/183 before the final response, some gateways answer right away
+        bool provisional_responses = true;
+        bool session_progress = false;
+        Callee callee = Callee::KEEP_RINGING;
+        // added to every response
+        unsigned long reply_delay_ms = 0;
+        // authenticated INVITE until 180/183
+        unsigned long ring_delay_ms = 0;
+        // 180/183 until the final response of the callee
+        unsigned long answer_delay_ms = 0;
+        // failure injection: the next requests are ignored
+        unsigned drop_requests = 0;
+        // failure injection: the next ACKs are ignored, the final response is repeated
+        unsigned drop_acks = 0;
+        // failure injection: REGISTER is answered with 500
+        bool server_error = false;
+    };
+
+    /**
+     * What happened to one call, times of the stand-in clock, 0 if it did not happen
+     */
+    struct Call
+    {
+        unsigned long first_invite_at = 0;
+        unsigned long authorized_invite_at = 0;
+        unsigned long ringing_at = 0;
+        unsigned long final_at = 0;
+        unsigned long acked_at = 0;
+        unsigned long cancelled_at = 0;
+        unsigned long ended_at = 0;
+        std::string final_status;
+        std::string to_tag;
+    };
+
+    struct Counters
+    {
+        // by method, retransmissions included
+        std::map<std::string, unsigned> requests;
+        // by status code, repetitions included
+        std::map<int, unsigned> responses;
+        unsigned retransmissions = 0;
+        unsigned auth_failures = 0;
+        unsigned stale_challenges = 0;
+        unsigned registrations = 0;
+
+        unsigned total_requests() const
+        {
+            unsigned sum = 0;
+            for (auto& entry : requests)
+                sum += entry.second;
+            return sum;
+        }
+
+        unsigned total_responses() const
+        {
+            unsigned sum = 0;
+            for (auto& entry : responses)
+                sum += entry.second;
+            return sum;
+        }
+    };
+
+    Config config;
+
+    /**
+     * Handle one datagram sent by the client
+     */
+    void receive(std::string_view datagram, unsigned long now)
+    {
+        std::string request(datagram);
+        std::string method = request.substr(0, request.find(' '));
+        if (method.empty() || method == "SIP/2.0")
+            return;
+        m_counters.requests[method]++;
+        if (config.drop_requests > 0)
+        {
+            config.drop_requests--;
+            return;
+        }
+        if (method == "ACK" && config.drop_acks > 0)
+        {
+            config.drop_acks--;
+            return;
+        }
+
+        // retransmission of a request whose transaction is already answered
+        std::string key = header(request, "Via") + " " + header(request, "CSeq");
+        auto answered = m_transactions.find(key);
+        if (method != "ACK" && answered != m_transactions.end())
+        {
+            m_counters.retransmissions++;
+            if (!answered->second.empty())
+                send(answered->second, now);
+            return;
+        }
+        if (method != "ACK")
+            m_transactions[key] = "";
+
+        if (method == "REGISTER")
+            on_register(request, key, now);
+        else if (method == "INVITE")
+            on_invite(request, key, now);
+        else if (method == "ACK")
+            on_ack(request, now);
+        else if (method == "CANCEL")
+            on_cancel(request, key, now);
+        else if (method == "BYE")
+            on_bye(request, key, now);
+        else
+            answer(request, key, "405 Method Not Allowed", now);
+    }
+
+    /**
+     * Take the next response that is due
+     *
+     * \param[out] datagram The response
+     */
+    bool poll(unsigned long now, std::string& datagram)
+    {
+        for (auto it = m_pending.begin(); it != m_pending.end();)
+        {
+            if ((long) (now - it->due) < 0)
+            {
+                ++it;
+                continue;
+            }
+            Pending pending = *it;
+            it = m_pending.erase(it);
+            Call* call = pending.call_id.empty() ? nullptr : find_call(pending.call_id);
+            if (pending.until_ack && pending.due != pending.first_sent && (call == nullptr || call->acked_at != 0))
+                // the ACK arrived since the last repetition
+                continue;
+            datagram = pending.data;
+            if (!pending.key.empty())
+                m_transactions[pending.key] = pending.data;
+            m_counters.responses[status_of(datagram)]++;
+            if (call != nullptr && pending.ringing && call->ringing_at == 0)
+                call->ringing_at = now;
+            if (call != nullptr && pending.until_ack && call->acked_at == 0 && now - pending.first_sent < 64 * T1)
+            {
+                // Timer G, the final response is repeated until the ACK arrives
+                pending.due = now + pending.interval;
+                pending.interval = std::min(pending.interval * 2, T2);
+                m_pending.push_back(pending);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    bool idle() const
+    {
+        return m_pending.empty();
+    }
+
+    bool is_registered() const
+    {
+        return m_registered;
+    }
+
+    /**
+     * Force new digest challenges, the old nonce is reported as stale
+     */
+    void new_nonce()
+    {
+        m_nonce = "5E3A" + std::to_string(++m_nonce_generation) + "C0FFEE";
+    }
+
+    const Counters& counters() const
+    {
+        return m_counters;
+    }
+
+    void reset_counters()
+    {
+        m_counters = Counters();
+    }
+
+    Call* find_call(const std::string& call_id)
+    {
+        auto it = m_calls.find(call_id);
+        return it == m_calls.end() ? nullptr : &it->second;
+    }
+
+    /**
+     * The call that was started last, nullptr if there was none
+     */
+    Call* last_call()
+    {
+        return find_call(m_last_call_id);
+    }
+
+    const std::string& last_call_id() const
+    {
+        return m_last_call_id;
+    }
+
+    /**
+     * All calls since the last forget_calls() by Call-ID
+     */
+    const std::map<std::string, Call>& calls() const
+    {
+        return m_calls;
+    }
+
+    /**
+     * Forget the finished calls, long runs would otherwise keep all of them
+     */
+    void forget_calls()
+    {
+        m_calls.clear();
+        m_transactions.clear();
+        m_last_call_id.clear();
+    }
+
+private:
+    static constexpr unsigned long T1 = 500;
+    static constexpr unsigned long T2 = 4000;
+
+    struct Pending
+    {
+        unsigned long due;
+        std::string data;
+        // Via and CSeq of the request, its retransmissions get this response once it is sent
+        std::string key;
+        std::string call_id;
+        bool ringing = false;
+        bool final = false;
+        bool until_ack = false;
+        unsigned long first_sent = 0;
+        unsigned long interval = T1;
+    };
+
+    void on_register(const std::string& request, const std::string& key, unsigned long now)
+    {
+        if (config.server_error)
+        {
+            answer(request, key, "500 Server Internal Error", now);
+            return;
+        }
+        if (!authorized(request, "REGISTER", config.register_challenge, key, now))
+            return;
+        uint32_t expires = to_number(header(request, "Expires"));
+        if (config.min_expires != 0 && expires < config.min_expires)
+        {
+            answer(request, key, "423 Interval Too Brief", now, "Min-Expires: " + std::to_string(config.min_expires) + "\r\n");
+            return;
+        }
+        m_registered = expires != 0;
+        m_counters.registrations++;
+        std::string contact = header(request, "Contact");
+        answer(request, key, "200 OK", now, "Contact: " + contact + ";expires=" + std::to_string(std::min(expires, config.expires)) + "\r\n");
+    }
+
+    void on_invite(const std::string& request, const std::string& key, unsigned long now)
+    {
+        std::string call_id = header(request, "Call-ID");
+        bool new_call = m_calls.find(call_id) == m_calls.end();
+        Call& call = m_calls[call_id];
+        if (new_call)
+        {
+            call.first_invite_at = now;
+            call.to_tag = "srv" + std::to_string(++m_tag_count);
+            m_last_call_id = call_id;
+            if (config.new_nonce_per_call)
+                new_nonce();
+        }
+        if (!authorized(request, "INVITE", config.invite_challenge, key, now))
+            return;
+        call.authorized_invite_at = now;
+        m_invites[call_id] = request;
+        Pending ringing;
+        ringing.due = now + config.reply_delay_ms + config.ring_delay_ms;
+        ringing.data = response(request, config.session_progress ? "183 Session Progress" : "180 Ringing", call.to_tag, "");
+        ringing.key = key;
+        ringing.call_id = call_id;
+        ringing.ringing = true;
+        if (config.provisional_responses)
+        {
+            send(response(request, "100 Trying", "", ""), now, key);
+            m_pending.push_back(ringing);
+        }
+
+        const char* status = nullptr;
+        std::string extra;
+        switch (config.callee)
+        {
+        case Callee::ANSWER:
+            status = "200 OK";
+            extra = "Contact: <" + request_uri(request) + ">\r\n";
+            break;
+        case Callee::BUSY_486:
+            status = "486 Busy Here";
+            break;
+        case Callee::DECLINE_603:
+            status = "603 Decline";
+            break;
+        default:
+            break;
+        }
+        if (status != nullptr)
+        {
+            Pending final;
+            final.due = ringing.due + config.answer_delay_ms;
+            final.data = response(request, status, call.to_tag, extra);
+            final.key = key;
+            final.call_id = call_id;
+            final.final = true;
+            final.until_ack = true;
+            final.first_sent = final.due;
+            m_pending.push_back(final);
+            call.final_status = status;
+            call.final_at = final.due;
+            call.acked_at = 0;
+        }
+    }
+
+    void on_ack(const std::string& request, unsigned long now)
+    {
+        Call* call = find_call(header(request, "Call-ID"));
+        if (call != nullptr && call->acked_at == 0)
+            call->acked_at = now;
+    }
+
+    void on_cancel(const std::string& request, const std::string& key, unsigned long now)
+    {
+        std::string call_id = header(request, "Call-ID");
+        Call* call = find_call(call_id);
+        if (call == nullptr)
+        {
+            answer(request, key, "481 Call/Transaction Does Not Exist", now);
+            return;
+        }
+        answer(request, key, "200 OK", now);
+        if (call->cancelled_at != 0 || (call->final_at != 0 && (long) (now - call->final_at) >= 0))
+            // the INVITE is already answered, the CANCEL has no effect
+            return;
+        call->cancelled_at = now;
+        // the callee stops ringing, a final response that is not sent yet is replaced by 487
+        for (auto it = m_pending.begin(); it != m_pending.end();)
+        {
+            if (it->call_id == call_id && (it->final || it->ringing))
+                it = m_pending.erase(it);
+            else
+                ++it;
+        }
+        const std::string& invite = m_invites[call_id];
+        Pending terminated;
+        terminated.due = now + config.reply_delay_ms;
+        terminated.data = response(invite, "487 Request Terminated", call->to_tag, "");
+        terminated.key = header(invite, "Via") + " " + header(invite, "CSeq");
+        terminated.call_id = call_id;
+        terminated.final = true;
+        terminated.until_ack = true;
+        terminated.first_sent = terminated.due;
+        m_pending.push_back(terminated);
+        call->final_status = "487 Request Terminated";
+        call->final_at = terminated.due;
+        call->acked_at = 0;
+    }
+
+    void on_bye(const std::string& request, const std::string& key, unsigned long now)
+    {
+        Call* call = find_call(header(request, "Call-ID"));
+        if (call == nullptr || call->final_status != "200 OK")
+        {
+            answer(request, key, "481 Call/Transaction Does Not Exist", now);
+            return;
+        }
+        if (call->ended_at == 0)
+            call->ended_at = now;
+        answer(request, key, "200 OK", now);
+    }
+
+    /**
+     * Check the credentials of the request, otherwise send the challenge
+     */
+    bool authorized(const std::string& request, const char* method, Challenge challenge, const std::string& key, unsigned long now)
+    {
+        if (challenge == Challenge::NONE)
+            return true;
+        bool proxy = challenge == Challenge::PROXY_AUTHENTICATE_407;
+        std::string credentials = header(request, proxy ? "Proxy-Authorization" : "Authorization");
+        bool stale = false;
+        if (!credentials.empty())
+        {
+            std::string ha1 = md5_hex(config.user + ":" + config.realm + ":" + config.password);
+            std::string ha2 = md5_hex(std::string(method) + ":" + parameter(credentials, "uri"));
+            std::string expected;
+            if (parameter(credentials, "qop") == "auth")
+                expected = md5_hex(ha1 + ":" + parameter(credentials, "nonce") + ":" + parameter(credentials, "nc") + ":" + parameter(credentials, "cnonce") + ":auth:" + ha2);
+            else
+                expected = md5_hex(ha1 + ":" + parameter(credentials, "nonce") + ":" + ha2);
+            bool valid = expected == parameter(credentials, "response") && parameter(credentials, "username") == config.user
+                && parameter(credentials, "realm") == config.realm;
+            if (valid && parameter(credentials, "nonce") == m_nonce)
+                return true;
+            if (valid)
+            {
+                stale = true;
+                m_counters.stale_challenges++;
+            }
+            else
+            {
+                m_counters.auth_failures++;
+            }
+        }
+        std::string line = proxy ? "Proxy-Authenticate" : "WWW-Authenticate";
+        line += ": Digest realm=\"" + config.realm + "\", nonce=\"" + m_nonce + "\"";
+        if (config.qop)
+            line += ", qop=\"auth\", opaque=\"5ccc069c403ebaf9\", algorithm=MD5";
+        if (stale)
+            line += ", stale=TRUE";
+        answer(request, key, proxy ? "407 Proxy Authentication Required" : "401 Unauthorized", now, line + "\r\n", std::strcmp(method, "INVITE") == 0);
+        return false;
+    }
+
+    void answer(const std::string& request, const std::string& key, const std::string& status, unsigned long now, const std::string& extra = "",
+        bool until_ack = false)
+    {
+        std::string call_id = header(request, "Call-ID");
+        Call* call = find_call(call_id);
+        Pending pending;
+        pending.due = now + config.reply_delay_ms;
+        pending.data = response(request, status, call != nullptr ? call->to_tag : "srv0", extra);
+        pending.key = key;
+        if (until_ack)
+        {
+            pending.call_id = call_id;
+            pending.until_ack = true;
+            pending.first_sent = pending.due;
+            // a new INVITE of the same call is acknowledged again
+            call->acked_at = 0;
+        }
+        m_pending.push_back(pending);
+    }
+
+    void send(const std::string& data, unsigned long now, const std::string& key = "")
+    {
+        Pending pending;
+        pending.due = now + config.reply_delay_ms;
+        pending.data = data;
+        pending.key = key;
+        m_pending.push_back(pending);
+    }
+
+    static std::string response(const std::string& request, const std::string& status, const std::string& to_tag, const std::string& extra)
+    {
+        std::string to = header(request, "To");
+        if (!to_tag.empty() && to.find(";tag=") == std::string::npos)
+            to += ";tag=" + to_tag;
+        return "SIP/2.0 " + status + "\r\nVia: " + header(request, "Via") + "\r\nFrom: " + header(request, "From") + "\r\nTo: " + to
+            + "\r\nCall-ID: " + header(request, "Call-ID") + "\r\nCSeq: " + header(request, "CSeq") + "\r\nUser-Agent: SipServerStandIn\r\n" + extra
+            + "Content-Length: 0\r\n\r\n";
+    }
+
+    static std::string request_uri(const std::string& request)
+    {
+        size_t start = request.find(' ') + 1;
+        return request.substr(start, request.find(' ', start) - start);
+    }
+
+    static std::string header(const std::string& message, const std::string& name)
+    {
+        size_t pos = message.find("\r\n" + name + ":");
+        if (pos == std::string::npos)
+            return "";
+        pos += name.size() + 3;
+        while (pos < message.size() && message[pos] == ' ')
+            pos++;
+        return message.substr(pos, message.find("\r\n", pos) - pos);
+    }
+
+    static std::string parameter(const std::string& line, const std::string& name)
+    {
+        size_t pos = 0;
+        while ((pos = line.find(name + "=", pos)) != std::string::npos)
+        {
+            // whole parameter names only, "nc" must not match "cnonce"
+            if (pos == 0 || line[pos - 1] == ' ' || line[pos - 1] == ',')
+                break;
+            pos++;
+        }
+        if (pos == std::string::npos)
+            return "";
+        pos += name.size() + 1;
+        if (line[pos] == '"')
+            return line.substr(pos + 1, line.find('"', pos + 1) - pos - 1);
+        return line.substr(pos, line.find_first_of(", ", pos) - pos);
+    }
+
+    static uint32_t to_number(const std::string& value)
+    {
+        return (uint32_t) strtoul(value.c_str(), nullptr, 10);
+    }
+
+    static int status_of(const std::string& response)
+    {
+        return atoi(response.c_str() + 8);
+    }
+
+    static std::string md5_hex(const std::string& input)
+    {
+        unsigned char hash[16];
+        mbedtls_l_md5((const unsigned char*) input.data(), input.size(), hash);
+        char text[33];
+        for (int i = 0; i < 16; i++)
+            snprintf(text + 2 * i, 3, "%02x", hash[i]);
+        return text;
+    }
+
+    std::string m_nonce = "5E3A0C0FFEE";
+    unsigned m_nonce_generation = 0;
+    unsigned m_tag_count = 0;
+    bool m_registered = false;
+    std::deque<Pending> m_pending;
+    // last response by Via and CSeq of the request
+    std::map<std::string, std::string> m_transactions;
+    std::map<std::string, Call> m_calls;
+    // authorized INVITE of each call, a CANCEL answers it with 487
+    std::map<std::string, std::string> m_invites;
+    std::string m_last_call_id;
+    Counters m_counters;
+};
@@ -0,0 +1,119 @@
+/**
+ * The SIP client must not touch the heap once it is running
+ *
+ * 10 000 answered and hung up calls run on the emulated network, every allocation made
+ * while the client is called is counted. The stand-in and the network are not counted.
+ */
+#include "sip_client/mbedtls_md5.h"
+#include "sip_client/sip_client.h"
+
+#include "sim_network.h"
+#include "sip_server.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static bool s_counting = false;
+static unsigned long s_allocations = 0;
+static unsigned long s_bytes = 0;
+
+void* operator new(size_t size)
+{
+    if (s_counting)
+    {
+        s_allocations++;
+        s_bytes += size;
+    }
+    void* pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+using SipClientT = SipClient<SimUdpClient, MbedtlsMd5, SimClock>;
+
+static constexpr unsigned CALLS = 10000;
+
+int main()
+{
+    SimNetwork network;
+    SipServerStandIn server;
+    server.config.callee = SipServerStandIn::Callee::ANSWER;
+    server.config.answer_delay_ms = 20;
+    SipClientT client("620", "secret", "192.168.1.1", "5060", "192.168.1.50");
+    SipClientEvent::Event last_event = SipClientEvent::Event::BUTTON_PRESS;
+    unsigned calls_ended = 0;
+    client.set_event_handler([&](const SipClientEvent& event) {
+        last_event = event.event;
+        if (event.event == SipClientEvent::Event::CALL_END)
+            calls_ended++;
+    });
+    client.init();
+
+    auto step = [&] {
+        network.now++;
+        s_counting = true;
+        client.run();
+        s_counting = false;
+        network.exchange(server);
+    };
+    auto run_until = [&](auto done) {
+        for (unsigned long i = 0; i < 60000 && !done(); i++)
+            step();
+        return done();
+    };
+
+    // the first registration may set up buffers, the calls after it must not
+    if (!run_until([&] { return client.isReadyToCall(); }))
+    {
+        printf("not registered\n");
+        return 1;
+    }
+    unsigned long registration_allocations = s_allocations;
+    s_allocations = 0;
+    s_bytes = 0;
+
+    unsigned long started = network.now;
+    for (unsigned i = 0; i < CALLS; i++)
+    {
+        s_counting = true;
+        int call = client.request_ring("**610", "Door");
+        s_counting = false;
+        if (call < 0 || !run_until([&] { return last_event == SipClientEvent::Event::CALL_START; }))
+        {
+            printf("call %u was not answered\n", i);
+            return 1;
+        }
+        // hang up once the ACK arrived
+        run_until([&] { return server.last_call()->acked_at != 0; });
+        s_counting = true;
+        client.request_cancel(call);
+        s_counting = false;
+        if (!run_until([&] { return last_event == SipClientEvent::Event::CALL_END && client.isReadyToCall(); }))
+        {
+            printf("call %u did not end\n", i);
+            return 1;
+        }
+        server.forget_calls();
+    }
+
+    printf("%u calls in %lu s of virtual time, %u ended with BYE\n", CALLS, (network.now - started) / 1000, calls_ended);
+    printf("allocations: %lu during registration, %lu (%lu bytes) during %u calls\n", registration_allocations, s_allocations, s_bytes, CALLS);
+    if (calls_ended != CALLS || s_allocations != 0)
+    {
+        printf("FAILED\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+/**
+ * Call queue of the module: which triggers start a call, are merged into one or are dropped
+ *
+ * The queue is checked on its own with calls that are marked active by hand, then the way
+ * SIPModule drives it, with the client ringing on the emulated network.
+ */
+#include "sip_client/mbedtls_md5.h"
+#include "sip_client/sip_call_queue.h"
+#include "sip_client/sip_client.h"
+
+#include "sim_network.h"
+#include "sip_server.h"
+
+#include <cstdio>
+#include <set>
+
+static constexpr unsigned long COALESCE_MS = 2000;
+
+using SipClientT = SipClient<SimUdpClient, MbedtlsMd5, SimClock>;
+using QueueT = SipCallQueue<4, 6>;
+
+static int s_failures = 0;
+
+#define CHECK(condition)                                                          \
+    do {                                                                          \
+        if (!(condition)) {                                                       \
+            printf("  FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition);       \
+            s_failures++;                                                         \
+        }                                                                         \
+    } while (0)
+
+static void counters()
+{
+    printf("queued, coalesced and dropped triggers\n");
+    QueueT queue(COALESCE_MS);
+    std::set<int> active;
+    auto is_active = [&](int call) { return active.count(call) != 0; };
+
+    // a trigger while the call waits is merged into it
+    CHECK(queue.push(0, 1000, is_active) == QueueT::Push::QUEUED);
+    CHECK(queue.push(0, 5000, is_active) == QueueT::Push::COALESCED);
+    // the queue holds one call per channel, a fifth channel does not fit
+    CHECK(queue.push(1, 5000, is_active) == QueueT::Push::QUEUED);
+    CHECK(queue.push(2, 5000, is_active) == QueueT::Push::QUEUED);
+    CHECK(queue.push(3, 5000, is_active) == QueueT::Push::QUEUED);
+    CHECK(queue.push(4, 5000, is_active) == QueueT::Push::DROPPED);
+    CHECK(queue.waiting() == 4);
+
+    // calls leave in trigger order
+    CHECK(queue.pop() == 0);
+    CHECK(queue.pop() == 1);
+    CHECK(queue.waiting() == 2);
+
+    // channel 0 rings long after its coalescing time, its triggers are still merged
+    queue.started(0, 0);
+    active.insert(0);
+    CHECK(queue.push(0, 60000, is_active) == QueueT::Push::COALESCED);
+    // channel 1 was not accepted by the client, only the coalescing time covers it
+    queue.started(1, -1);
+    CHECK(queue.push(1, 5000 + COALESCE_MS - 1, is_active) == QueueT::Push::COALESCED);
+    CHECK(queue.push(1, 5000 + COALESCE_MS, is_active) == QueueT::Push::QUEUED);
+
+    // the call of channel 0 ended, the next trigger is a new call
+    active.erase(0);
+    CHECK(queue.push(0, 61000, is_active) == QueueT::Push::QUEUED);
+    CHECK(queue.pop() == 2);
+    CHECK(queue.pop() == 3);
+    CHECK(queue.pop() == 1);
+    CHECK(queue.pop() == 0);
+    CHECK(queue.empty());
+
+    // the handle of channel 0 is reused by channel 5, it does not keep channel 0 busy
+    CHECK(queue.push(5, 61000, is_active) == QueueT::Push::QUEUED);
+    CHECK(queue.pop() == 5);
+    queue.started(5, 0);
+    active.insert(0);
+    CHECK(queue.push(0, 70000, is_active) == QueueT::Push::QUEUED);
+    CHECK(queue.push(5, 70000, is_active) == QueueT::Push::COALESCED);
+
+    CHECK(queue.queued() == 8);
+    CHECK(queue.coalesced() == 4);
+    CHECK(queue.dropped() == 1);
+}
+
+/**
+ * Triggers of a channel while its call rings for the configured 15 s do not start a second
+ * call, the first trigger after the call was cancelled does
+ */
+static void ringing_call()
+{
+    printf("triggers while the call rings\n");
+    SimNetwork network;
+    SipServerStandIn server;
+    server.config.callee = SipServerStandIn::Callee::KEEP_RINGING;
+    SipClientT client("620", "secret", "192.168.1.1", "5060", "192.168.1.50");
+    client.init();
+    QueueT queue(COALESCE_MS);
+    SipCallTarget target;
+    target.prepare("**610", "192.168.1.1");
+    auto is_active = [&](int call) { return client.isCallActive(call); };
+
+    // one pass of SIPModule::loop()
+    auto step = [&] {
+        network.now++;
+        client.run();
+        while (!queue.empty() && client.isReadyToCall())
+        {
+            auto channel = queue.pop();
+            queue.started(channel, client.request_ring(target, "555", 15000));
+        }
+        network.exchange(server);
+    };
+    auto run_until = [&](auto done) {
+        for (unsigned long i = 0; i < 60000 && !done(); i++)
+            step();
+        return done();
+    };
+    auto invites = [&] { return server.calls().size(); };
+
+    CHECK(run_until([&] { return client.isReadyToCall(); }));
+    auto started = network.now;
+    CHECK(queue.push(0, network.now, is_active) == QueueT::Push::QUEUED);
+    CHECK(run_until([&] { return server.last_call() != nullptr && server.last_call()->ringing_at != 0; }));
+
+    // retrigger every second while it rings
+    while (network.now - started < 14000)
+    {
+        if (network.now % 1000 == 0)
+            CHECK(queue.push(0, network.now, is_active) == QueueT::Push::COALESCED);
+        step();
+    }
+    CHECK(invites() == 1);
+    CHECK(client.get_active_calls() == 1);
+
+    CHECK(run_until([&] { return client.get_active_calls() == 0; }));
+    CHECK(network.now - started >= 15000);
+    CHECK(queue.push(0, network.now, is_active) == QueueT::Push::QUEUED);
+    CHECK(run_until([&] { return invites() == 2; }));
+    CHECK(queue.queued() == 2);
+    CHECK(queue.coalesced() >= 10);
+    CHECK(queue.dropped() == 0);
+}
+
+int main()
+{
+    counters();
+    ringing_call();
+    if (s_failures != 0)
+    {
+        printf("%d checks failed\n", s_failures);
+        return 1;
+    }
+    printf("all call queue checks passed\n");
+    return 0;
+}
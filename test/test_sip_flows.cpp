@@ -0,0 +1,396 @@
+/**
+ * Full call flows of the SIP client against the registrar/PBX stand-in on localhost
+ *
+ * Every flow prints the number of requests and responses on the wire and the wall-clock
+ * time it took, so a regression of the call setup time shows up on a plain Linux box.
+ */
+#include "sip_client/posix_udp_client.h"
+#include "sip_client/mbedtls_md5.h"
+#include "sip_client/sip_client.h"
+
+#include "sip_server.h"
+#include "udp_loopback.h"
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// the client always binds port 5060, the stand-in listens next to it
+static constexpr uint16_t SERVER_PORT = 15060;
+
+using SipClientT = SipClient<PosixUdpClient, MbedtlsMd5>;
+
+static int s_failures = 0;
+
+#define CHECK(condition)                                                          \
+    do {                                                                          \
+        if (!(condition)) {                                                       \
+            printf("  FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition);       \
+            s_failures++;                                                         \
+        }                                                                         \
+    } while (0)
+
+/**
+ * One client and one stand-in talking over UDP on localhost
+ */
+class Flow
+{
+public:
+    explicit Flow(const char* name)
+    : m_name(name)
+    , m_loopback(server)
+    {
+    }
+
+    ~Flow()
+    {
+        report();
+    }
+
+    bool start()
+    {
+        if (!m_loopback.open(SERVER_PORT))
+        {
+            printf("  FAILED to open port %u\n", (unsigned) SERVER_PORT);
+            s_failures++;
+            return false;
+        }
+        client.set_event_handler([this](const SipClientEvent& event) { events.push_back(event); });
+        m_started = millis();
+        return client.init();
+    }
+
+    /**
+     * Run client and stand-in until done() holds, false if the timeout expired first
+     */
+    bool run_until(const std::function<bool()>& done, unsigned long timeout_ms = 5000)
+    {
+        unsigned long start = millis();
+        while (!done())
+        {
+            if (millis() - start >= timeout_ms)
+                return false;
+            step();
+        }
+        return true;
+    }
+
+    void run_for(unsigned long duration_ms)
+    {
+        unsigned long start = millis();
+        while (millis() - start < duration_ms)
+            step();
+    }
+
+    bool has_event(SipClientEvent::Event event) const
+    {
+        for (auto& received : events)
+        {
+            if (received.event == event)
+                return true;
+        }
+        return false;
+    }
+
+    const SipClientEvent* last_event() const
+    {
+        return events.empty() ? nullptr : &events.back();
+    }
+
+    unsigned requests(const char* method) const
+    {
+        auto it = server.counters().requests.find(method);
+        return it == server.counters().requests.end() ? 0 : it->second;
+    }
+
+    unsigned responses(int status) const
+    {
+        auto it = server.counters().responses.find(status);
+        return it == server.counters().responses.end() ? 0 : it->second;
+    }
+
+    /**
+     * Time of the next step of the flow, printed with the report
+     */
+    void mark(const char* label)
+    {
+        m_marks.push_back({ label, millis() - m_started });
+    }
+
+    SipServerStandIn server;
+    SipClientT client{ "620", "secret", "127.0.0.1", std::to_string(SERVER_PORT), "127.0.0.1" };
+    std::vector<SipClientEvent> events;
+
+private:
+    void step()
+    {
+        client.run();
+        m_loopback.exchange(millis());
+        usleep(50);
+    }
+
+    void report()
+    {
+        client.stop();
+        const auto& counters = server.counters();
+        printf("%-28s %3u requests %3u responses %7lu ms |", m_name, counters.total_requests(), counters.total_responses(), millis() - m_started);
+        for (auto& entry : counters.requests)
+            printf(" %s=%u", entry.first.c_str(), entry.second);
+        for (auto& entry : counters.responses)
+            printf(" %d=%u", entry.first, entry.second);
+        for (auto& mark : m_marks)
+            printf(" %s@%lums", mark.first, mark.second);
+        printf("\n");
+    }
+
+    const char* m_name;
+    UdpLoopback<SipServerStandIn> m_loopback;
+    unsigned long m_started = 0;
+    std::vector<std::pair<const char*, unsigned long>> m_marks;
+};
+
+static void register_with_challenge()
+{
+    Flow flow("register");
+    CHECK(flow.start());
+    CHECK(flow.run_until([&] { return flow.client.isConnected(); }));
+    flow.mark("registered");
+    CHECK(flow.requests("REGISTER") == 2);
+    CHECK(flow.responses(401) == 1);
+    CHECK(flow.responses(200) == 1);
+    CHECK(flow.server.counters().auth_failures == 0);
+}
+
+static void register_with_qop()
+{
+    Flow flow("register qop=auth");
+    flow.server.config.qop = true;
+    CHECK(flow.start());
+    CHECK(flow.run_until([&] { return flow.client.isConnected(); }));
+    flow.mark("registered");
+    CHECK(flow.requests("REGISTER") == 2);
+    CHECK(flow.server.counters().auth_failures == 0);
+}
+
+static void register_interval_too_brief()
+{
+    Flow flow("register 423");
+    flow.server.config.min_expires = 7200;
+    CHECK(flow.start());
+    CHECK(flow.run_until([&] { return flow.client.isConnected(); }));
+    flow.mark("registered");
+    CHECK(flow.responses(423) == 1);
+    // the retry is a new transaction, the server must not see it as a retransmission
+    CHECK(flow.server.counters().retransmissions == 0);
+}
+
+static void register_lost_request()
+{
+    Flow flow("register lost request");
+    flow.server.config.drop_requests = 1;
+    CHECK(flow.start());
+    CHECK(flow.run_until([&] { return flow.client.isConnected(); }));
+    flow.mark("registered");
+    CHECK(flow.requests("REGISTER") == 3);
+}
+
+static void register_server_error()
+{
+    Flow flow("register 500");
+    flow.server.config.server_error = true;
+    CHECK(flow.start());
+    flow.run_for(300);
+    CHECK(!flow.client.isConnected());
+    flow.server.config.server_error = false;
+    CHECK(flow.run_until([&] { return flow.client.isConnected(); }));
+    flow.mark("registered");
+    CHECK(flow.responses(500) == 1);
+}
+
+static void register_new_realm()
+{
+    Flow flow("register new realm");
+    CHECK(flow.start());
+    CHECK(flow.run_until([&] { return flow.client.isConnected(); }));
+    flow.mark("registered");
+    // the network comes back with another gateway
+    flow.client.stop();
+    flow.server.config.realm = "other.box";
+    flow.server.new_nonce();
+    CHECK(flow.client.init());
+    CHECK(flow.run_until([&] { return flow.client.isConnected(); }));
+    flow.mark("registered again");
+    CHECK(flow.server.counters().auth_failures == 1);
+}
+
+static void call_answered(bool provisional)
+{
+    Flow flow(provisional ? "call answered, bye" : "call answered without 180");
+    flow.server.config.callee = SipServerStandIn::Callee::ANSWER;
+    flow.server.config.provisional_responses = provisional;
+    flow.server.config.ring_delay_ms = 20;
+    flow.server.config.answer_delay_ms = 50;
+    CHECK(flow.start());
+    CHECK(flow.run_until([&] { return flow.client.isReadyToCall(); }));
+    flow.mark("registered");
+    CHECK(flow.client.request_ring("**610", "Door") == 0);
+    CHECK(flow.run_until([&] { return flow.has_event(SipClientEvent::Event::CALL_START); }));
+    flow.mark("answered");
+    CHECK(flow.run_until([&] { return flow.server.last_call() != nullptr && flow.server.last_call()->acked_at != 0; }));
+    flow.client.request_cancel();
+    CHECK(flow.run_until([&] { return flow.has_event(SipClientEvent::Event::CALL_END); }));
+    flow.mark("ended");
+    CHECK(flow.requests("BYE") == 1);
+    CHECK(flow.responses(200) == 3);
+    CHECK(flow.client.isReadyToCall());
+}
+
+static void call_cancelled()
+{
+    Flow flow("call 183, cancel, 487");
+    flow.server.config.session_progress = true;
+    CHECK(flow.start());
+    CHECK(flow.run_until([&] { return flow.client.isReadyToCall(); }));
+    CHECK(flow.client.request_ring("**610", "Door") == 0);
+    CHECK(flow.run_until([&] { return flow.server.last_call() != nullptr && flow.server.last_call()->ringing_at != 0; }));
+    flow.mark("ringing");
+    flow.client.request_cancel();
+    CHECK(flow.run_until([&] { return flow.has_event(SipClientEvent::Event::CALL_CANCELLED); }));
+    flow.mark("cancelled");
+    CHECK(flow.responses(183) == 1);
+    CHECK(flow.requests("CANCEL") == 1);
+    CHECK(flow.responses(487) == 1);
+    CHECK(flow.server.last_call()->acked_at != 0);
+    CHECK(flow.client.isReadyToCall());
+}
+
+static void call_rejected(SipServerStandIn::Callee callee, SipClientEvent::CancelReason reason, int status)
+{
+    Flow flow(status == 486 ? "call busy 486" : "call declined 603");
+    flow.server.config.callee = callee;
+    flow.server.config.answer_delay_ms = 30;
+    CHECK(flow.start());
+    CHECK(flow.run_until([&] { return flow.client.isReadyToCall(); }));
+    CHECK(flow.client.request_ring("**610", "Door") == 0);
+    CHECK(flow.run_until([&] { return flow.has_event(SipClientEvent::Event::CALL_CANCELLED); }));
+    flow.mark("rejected");
+    CHECK(flow.last_event()->cancel_reason == reason);
+    CHECK(flow.responses(status) == 1);
+    CHECK(flow.server.last_call()->acked_at != 0);
+    CHECK(flow.client.isReadyToCall());
+}
+
+static void call_stale_proxy_nonce()
+{
+    Flow flow("call 407 with new nonce");
+    flow.server.config.invite_challenge = SipServerStandIn::Challenge::PROXY_AUTHENTICATE_407;
+    flow.server.config.new_nonce_per_call = true;
+    flow.server.config.qop = true;
+    CHECK(flow.start());
+    CHECK(flow.run_until([&] { return flow.client.isReadyToCall(); }));
+    CHECK(flow.client.request_ring("**610", "Door") == 0);
+    CHECK(flow.run_until([&] { return flow.server.last_call() != nullptr && flow.server.last_call()->ringing_at != 0; }));
+    flow.mark("ringing");
+    flow.client.request_cancel();
+    CHECK(flow.run_until([&] { return flow.has_event(SipClientEvent::Event::CALL_CANCELLED); }));
+    CHECK(flow.responses(407) == 1);
+    CHECK(flow.server.counters().auth_failures == 0);
+}
+
+static void call_proxy_challenge_then_refresh()
+{
+    Flow flow("call 407, register refresh");
+    flow.server.config.invite_challenge = SipServerStandIn::Challenge::PROXY_AUTHENTICATE_407;
+    flow.server.config.qop = true;
+    // a refresh after one second
+    flow.server.config.expires = 2;
+    CHECK(flow.start());
+    CHECK(flow.run_until([&] { return flow.client.isReadyToCall(); }));
+    CHECK(flow.client.request_ring("**610", "Door") == 0);
+    CHECK(flow.run_until([&] { return flow.server.last_call() != nullptr && flow.server.last_call()->ringing_at != 0; }));
+    flow.mark("ringing");
+    flow.client.request_cancel();
+    CHECK(flow.run_until([&] { return flow.has_event(SipClientEvent::Event::CALL_CANCELLED); }));
+    CHECK(flow.run_until([&] { return flow.server.counters().registrations == 2; }));
+    flow.mark("refreshed");
+    // the refresh answers the 401 of the registrar, not the 407 of the INVITE
+    CHECK(flow.requests("REGISTER") == 3);
+    CHECK(flow.responses(401) == 1);
+    CHECK(flow.responses(407) == 1);
+    CHECK(flow.server.counters().auth_failures == 0);
+    // and the next call answers the 407 right away
+    std::string first_call = flow.server.last_call_id();
+    CHECK(flow.client.request_ring("**610", "Door") == 0);
+    CHECK(flow.run_until([&] { return flow.server.last_call_id() != first_call && flow.server.last_call()->ringing_at != 0; }));
+    flow.mark("ringing again");
+    CHECK(flow.requests("INVITE") == 3);
+    CHECK(flow.responses(407) == 1);
+}
+
+static void call_ack_lost(SipServerStandIn::Callee callee)
+{
+    bool answer = callee == SipServerStandIn::Callee::ANSWER;
+    Flow flow(answer ? "call answered, ACK lost" : "call busy, ACK lost");
+    flow.server.config.callee = callee;
+    flow.server.config.drop_acks = 1;
+    CHECK(flow.start());
+    CHECK(flow.run_until([&] { return flow.client.isReadyToCall(); }));
+    CHECK(flow.client.request_ring("**610", "Door") == 0);
+    CHECK(flow.run_until([&] { return flow.has_event(answer ? SipClientEvent::Event::CALL_START : SipClientEvent::Event::CALL_CANCELLED); }));
+    flow.mark(answer ? "answered" : "rejected");
+    // the final response is repeated after T1 and acknowledged again, by a call in progress or an ended one
+    CHECK(flow.run_until([&] { return flow.server.last_call()->acked_at != 0; }));
+    flow.mark("acked again");
+    CHECK(flow.requests("ACK") == 2);
+    CHECK(flow.responses(answer ? 200 : 486) == (answer ? 3u : 2u));
+    if (answer)
+    {
+        flow.client.request_cancel();
+        CHECK(flow.run_until([&] { return flow.has_event(SipClientEvent::Event::CALL_END); }));
+        CHECK(flow.server.last_call()->ended_at != 0);
+    }
+    CHECK(flow.client.isReadyToCall());
+}
+
+static void call_deadline()
+{
+    Flow flow("call cancelled at deadline");
+    flow.server.config.reply_delay_ms = 40;
+    CHECK(flow.start());
+    CHECK(flow.run_until([&] { return flow.client.isReadyToCall(); }));
+    flow.mark("registered");
+    SipCallTarget target;
+    target.prepare("**610", "127.0.0.1");
+    CHECK(flow.client.request_ring(target, "Door", 400) == 0);
+    CHECK(flow.run_until([&] { return flow.has_event(SipClientEvent::Event::CALL_CANCELLED); }));
+    flow.mark("cancelled");
+    CHECK(flow.requests("CANCEL") == 1);
+}
+
+int main()
+{
+    register_with_challenge();
+    register_with_qop();
+    register_interval_too_brief();
+    register_lost_request();
+    register_server_error();
+    register_new_realm();
+    call_answered(true);
+    call_answered(false);
+    call_cancelled();
+    call_rejected(SipServerStandIn::Callee::BUSY_486, SipClientEvent::CancelReason::TARGET_BUSY, 486);
+    call_rejected(SipServerStandIn::Callee::DECLINE_603, SipClientEvent::CancelReason::CALL_DECLINED, 603);
+    call_stale_proxy_nonce();
+    call_proxy_challenge_then_refresh();
+    call_ack_lost(SipServerStandIn::Callee::ANSWER);
+    call_ack_lost(SipServerStandIn::Callee::BUSY_486);
+    call_deadline();
+    if (s_failures != 0)
+    {
+        printf("%d checks failed\n", s_failures);
+        return 1;
+    }
+    printf("all flows passed\n");
+    return 0;
+}
@@ -0,0 +1,174 @@
+/**
+ * SipFramer: several SIP messages in one datagram or stream read, framed by the empty
+ * line after the header and Content-Length
+ */
+#include "sip_client/sip_framer.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static int s_failures = 0;
+
+#define CHECK(condition)                                                          \
+    do {                                                                          \
+        if (!(condition)) {                                                       \
+            printf("  FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition);       \
+            s_failures++;                                                         \
+        }                                                                         \
+    } while (0)
+
+static const std::string TRYING =
+    "SIP/2.0 100 Trying\r\n"
+    "Via: SIP/2.0/UDP 192.168.178.50:5060;branch=z9hG4bK-1714636915;rport=5060\r\n"
+    "Call-ID: 846930886@192.168.178.50\r\n"
+    "CSeq: 2 INVITE\r\n"
+    "Content-Length: 0\r\n"
+    "\r\n";
+
+static const std::string SDP =
+    "v=0\r\n"
+    "o=- 1957747793 1957747793 IN IP4 192.168.178.1\r\n"
+    "c=IN IP4 192.168.178.1\r\n"
+    "m=audio 7078 RTP/AVP 8 101\r\n";
+
+static const std::string PROGRESS =
+    "SIP/2.0 183 Session Progress\r\n"
+    "Via: SIP/2.0/UDP 192.168.178.50:5060;branch=z9hG4bK-1714636915;rport=5060\r\n"
+    "Call-ID: 846930886@192.168.178.50\r\n"
+    "CSeq: 2 INVITE\r\n"
+    "Content-Type: application/sdp\r\n"
+    "l: " + std::to_string(SDP.size()) + "\r\n"
+    "\r\n" + SDP;
+
+static const std::string UNAUTHORIZED =
+    "SIP/2.0 401 Unauthorized\r\n"
+    "Via: SIP/2.0/UDP 192.168.178.50:5060;branch=z9hG4bK-1714636916;rport=5060\r\n"
+    "Call-ID: 1804289383@192.168.178.50\r\n"
+    "CSeq: 8 REGISTER\r\n"
+    "WWW-Authenticate: Digest realm=\"fritz.box\", nonce=\"7C9E2A41B3D5F687\"\r\n"
+    "CONTENT-LENGTH: 0\r\n"
+    "\r\n";
+
+static std::vector<std::string> frame(const std::string& data, bool stream, size_t* consumed = nullptr)
+{
+    SipFramer framer(data.data(), data.size(), stream);
+    std::vector<std::string> messages;
+    std::string_view message;
+    while (framer.next(message))
+        messages.emplace_back(message);
+    if (consumed != nullptr)
+        *consumed = framer.consumed();
+    return messages;
+}
+
+static void merged_datagram()
+{
+    printf("three responses in one datagram\n");
+    auto messages = frame(TRYING + PROGRESS + UNAUTHORIZED, false);
+    CHECK(messages.size() == 3);
+    if (messages.size() != 3)
+        return;
+    CHECK(messages[0] == TRYING);
+    CHECK(messages[1] == PROGRESS);
+    CHECK(messages[2] == UNAUTHORIZED);
+
+    // every message parses on its own, the body ends where Content-Length says
+    SipPacket progress(messages[1].data(), messages[1].size());
+    CHECK(progress.parse());
+    CHECK(progress.get_status() == SipPacket::Status::SESSION_PROGRESS_183);
+    CHECK(progress.get_content_length() == SDP.size());
+    SipPacket unauthorized(messages[2].data(), messages[2].size());
+    CHECK(unauthorized.parse());
+    CHECK(unauthorized.get_status() == SipPacket::Status::UNAUTHORIZED_401);
+    CHECK(unauthorized.get_nonce() == "7C9E2A41B3D5F687");
+}
+
+static void keep_alives()
+{
+    printf("CRLF keep-alives between messages\n");
+    size_t consumed = 0;
+    auto messages = frame("\r\n\r\n" + TRYING + "\r\n" + UNAUTHORIZED + "\r\n", false, &consumed);
+    CHECK(messages.size() == 2);
+    CHECK(!messages.empty() && messages.front() == TRYING);
+    CHECK(messages.size() < 2 || messages[1] == UNAUTHORIZED);
+    CHECK(consumed == 4 + TRYING.size() + 2 + UNAUTHORIZED.size() + 2);
+}
+
+static void without_content_length()
+{
+    printf("messages without Content-Length\n");
+    std::string header = TRYING.substr(0, TRYING.find("Content-Length")) + "\r\n";
+    // a datagram carries one message whose body runs to its end
+    auto datagram = frame(header + "Signal=5\r\n", false);
+    CHECK(datagram.size() == 1);
+    CHECK(!datagram.empty() && datagram.front() == header + "Signal=5\r\n");
+    // on a stream it has no body, the next message follows right after the header
+    auto stream = frame(header + UNAUTHORIZED, true);
+    CHECK(stream.size() == 2);
+    CHECK(!stream.empty() && stream.front() == header);
+    CHECK(stream.size() < 2 || stream[1] == UNAUTHORIZED);
+}
+
+static void truncated_datagram()
+{
+    printf("truncated datagrams\n");
+    // shorter body than announced, what arrived is passed on
+    std::string short_body = PROGRESS.substr(0, PROGRESS.size() - 10);
+    auto messages = frame(TRYING + short_body, false);
+    CHECK(messages.size() == 2);
+    CHECK(messages.size() < 2 || messages[1] == short_body);
+
+    // header cut off, the parser reports it
+    std::string short_header = UNAUTHORIZED.substr(0, 60);
+    messages = frame(TRYING + short_header, false);
+    CHECK(messages.size() == 2);
+    if (messages.size() == 2)
+    {
+        CHECK(messages[1] == short_header);
+        SipPacket packet(messages[1].data(), messages[1].size());
+        CHECK(!packet.parse());
+    }
+}
+
+static void truncated_stream()
+{
+    printf("incomplete messages of a stream\n");
+    std::string data = TRYING + PROGRESS + UNAUTHORIZED;
+    // every cut returns the complete messages in front of it and keeps the rest for the next read
+    for (size_t cut = 0; cut <= data.size(); cut++)
+    {
+        size_t consumed = 0;
+        auto messages = frame(data.substr(0, cut), true, &consumed);
+        size_t expected = cut >= TRYING.size() + PROGRESS.size() + UNAUTHORIZED.size() ? 3
+            : cut >= TRYING.size() + PROGRESS.size()                                 ? 2
+            : cut >= TRYING.size()                                                   ? 1
+                                                                                     : 0;
+        CHECK(messages.size() == expected);
+        size_t expected_consumed = 0;
+        for (auto& message : messages)
+            expected_consumed += message.size();
+        CHECK(consumed == expected_consumed);
+        if (messages.size() != expected)
+        {
+            printf("  cut at %zu of %zu\n", cut, data.size());
+            break;
+        }
+    }
+}
+
+int main()
+{
+    merged_datagram();
+    keep_alives();
+    without_content_length();
+    truncated_datagram();
+    truncated_stream();
+    if (s_failures != 0)
+    {
+        printf("%d checks failed\n", s_failures);
+        return 1;
+    }
+    printf("all framer checks passed\n");
+    return 0;
+}
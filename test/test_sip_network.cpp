@@ -0,0 +1,328 @@
+/**
+ * The SIP client on an emulated lossy network with a virtual clock
+ *
+ * Hours of registration refreshes and thousands of calls run in seconds. For every
+ * impairment the distribution of the time from request_ring() until the phone rings
+ * at the stand-in is printed, and the time the client needs to place a call again
+ * after the link was down.
+ */
+#include "sip_client/mbedtls_md5.h"
+#include "sip_client/sip_client.h"
+
+#include "sim_network.h"
+#include "sip_server.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+using SipClientT = SipClient<SimUdpClient, MbedtlsMd5, SimClock>;
+
+static int s_failures = 0;
+
+#define CHECK(condition)                                                          \
+    do {                                                                          \
+        if (!(condition)) {                                                       \
+            printf("  FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition);       \
+            s_failures++;                                                         \
+        }                                                                         \
+    } while (0)
+
+static constexpr unsigned long SECOND = 1000;
+static constexpr unsigned long MINUTE = 60 * SECOND;
+static constexpr unsigned long HOUR = 60 * MINUTE;
+
+/**
+ * Client and stand-in on one emulated network
+ */
+class Bench
+{
+public:
+    explicit Bench(uint32_t seed)
+    : network(seed)
+    , m_random(seed * 31 + 7)
+    {
+        server.config.expires = 300;
+        client.set_event_handler([this](const SipClientEvent& event) {
+            if (event.event != SipClientEvent::Event::BUTTON_PRESS)
+            {
+                m_last_event = event;
+                events.push_back(event);
+            }
+        });
+        client.init();
+    }
+
+    void step()
+    {
+        network.now++;
+        client.run();
+        network.exchange(server);
+        if (client.isConnected())
+            m_connected_ms++;
+        m_total_ms++;
+    }
+
+    bool run_until(const std::function<bool()>& done, unsigned long timeout_ms)
+    {
+        unsigned long start = network.now;
+        while (!done())
+        {
+            if (network.now - start >= timeout_ms)
+                return false;
+            step();
+        }
+        return true;
+    }
+
+    void run_for(unsigned long duration_ms)
+    {
+        unsigned long start = network.now;
+        while (network.now - start < duration_ms)
+            step();
+    }
+
+    /**
+     * Ring, cancel once the phone rings and wait until the call is over
+     *
+     * \return time until the stand-in rang the phone, -1 if it never did
+     */
+    long call()
+    {
+        if (!run_until([&] { return client.isReadyToCall(); }, 2 * MINUTE))
+            return -1;
+        unsigned long trigger = network.now;
+        m_last_trigger = trigger;
+        int handle = client.request_ring("**610", "Door");
+        if (handle < 0)
+            return -1;
+        m_last_event.call = -1;
+        // Timer B gives up on the INVITE after 32 s
+        bool rang = run_until([&] {
+            auto call = server.last_call();
+            return (call != nullptr && call->first_invite_at - trigger < MINUTE && call->ringing_at != 0) || m_last_event.call == handle;
+        }, 40 * SECOND);
+        auto call = server.last_call();
+        long latency = rang && call != nullptr && call->ringing_at != 0 ? (long) (call->ringing_at - trigger) : -1;
+        client.request_cancel(handle);
+        run_until([&] { return m_last_event.call == handle; }, 2 * MINUTE);
+        // the phone stays quiet for a while, so the next call is not hit by Timer G of this one
+        run_for(SECOND + m_random.up_to(4 * SECOND));
+        server.forget_calls();
+        events.clear();
+        return latency;
+    }
+
+    unsigned long last_trigger() const
+    {
+        return m_last_trigger;
+    }
+
+    bool has_event(SipClientEvent::Event event, int call) const
+    {
+        for (auto& received : events)
+        {
+            if (received.event == event && received.call == call)
+                return true;
+        }
+        return false;
+    }
+
+    /**
+     * Share of the time the client was registered since the last query
+     */
+    double availability()
+    {
+        double result = m_total_ms == 0 ? 0 : (double) m_connected_ms / m_total_ms;
+        m_connected_ms = 0;
+        m_total_ms = 0;
+        return result;
+    }
+
+    SimNetwork network;
+    SipServerStandIn server;
+    SipClientT client{ "620", "secret", "192.168.1.1", "5060", "192.168.1.50" };
+    // cleared by the scenario
+    std::vector<SipClientEvent> events;
+
+private:
+    SimRandom m_random;
+    SipClientEvent m_last_event;
+    unsigned long m_last_trigger = 0;
+    unsigned long m_connected_ms = 0;
+    unsigned long m_total_ms = 0;
+};
+
+struct Distribution
+{
+    std::vector<long> samples;
+    unsigned failed = 0;
+
+    void add(long sample)
+    {
+        if (sample < 0)
+            failed++;
+        else
+            samples.push_back(sample);
+    }
+
+    long percentile(double p)
+    {
+        if (samples.empty())
+            return -1;
+        std::sort(samples.begin(), samples.end());
+        size_t index = std::min(samples.size() - 1, (size_t) (p * samples.size()));
+        return samples[index];
+    }
+
+    void print(const char* name)
+    {
+        printf("%-34s %5zu calls %3u failed | p50 %5ld ms  p90 %5ld ms  p99 %5ld ms  max %5ld ms\n", name, samples.size(), failed,
+               percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0));
+    }
+};
+
+static SimNetwork::ChannelT::Config impairment(double loss)
+{
+    SimNetwork::ChannelT::Config config;
+    config.loss = loss;
+    config.duplicate = loss > 0 ? 0.02 : 0;
+    config.reorder = loss > 0 ? 0.05 : 0;
+    config.delay_ms = 5;
+    config.jitter_ms = loss > 0 ? 15 : 0;
+    return config;
+}
+
+/**
+ * Calls on a link with the given loss in both directions
+ */
+static void calls_under_loss(const char* name, double loss, unsigned calls, long p99_limit, unsigned max_failed)
+{
+    Bench bench(42);
+    bench.network.configure(impairment(loss));
+    Distribution ringing;
+    for (unsigned i = 0; i < calls; i++)
+        ringing.add(bench.call());
+    ringing.print(name);
+    const auto& counters = bench.server.counters();
+    printf("%-34s %5u INVITE  %5u retransmissions  %3u auth failures  availability %.4f\n", "", counters.requests.count("INVITE") ? counters.requests.at("INVITE") : 0,
+           counters.retransmissions, counters.auth_failures, bench.availability());
+    CHECK(ringing.failed <= max_failed);
+    CHECK(ringing.percentile(0.99) >= 0 && ringing.percentile(0.99) <= p99_limit);
+    CHECK(counters.auth_failures == 0);
+}
+
+/**
+ * Registration refreshes for hours, the client must stay registered
+ */
+static void refreshes(const char* name, double loss, unsigned long duration, double min_availability)
+{
+    Bench bench(7);
+    bench.network.configure(impairment(loss));
+    bench.run_for(duration);
+    double availability = bench.availability();
+    const auto& counters = bench.server.counters();
+    printf("%-34s %5u registrations  %5u REGISTER  availability %.4f\n", name, counters.registrations, counters.requests.at("REGISTER"), availability);
+    CHECK(availability >= min_availability);
+    CHECK(counters.registrations >= duration / (bench.server.config.expires * SECOND));
+}
+
+/**
+ * Two calls at once, one is cancelled while both ring, the other one is answered and
+ * hung up with BYE
+ */
+static void parallel_calls(const char* name, double loss, unsigned rounds, unsigned max_failed)
+{
+    Bench bench(11);
+    bench.network.configure(impairment(loss));
+    bench.server.config.callee = SipServerStandIn::Callee::ANSWER;
+    bench.server.config.answer_delay_ms = 3 * SECOND;
+    auto ringing = [&] {
+        unsigned count = 0;
+        for (auto& call : bench.server.calls())
+            count += call.second.ringing_at != 0 && call.second.final_at - call.second.ringing_at == bench.server.config.answer_delay_ms;
+        return count;
+    };
+    unsigned failed = 0;
+    for (unsigned i = 0; i < rounds; i++)
+    {
+        if (!bench.run_until([&] { return bench.client.isReadyToCall(); }, 2 * MINUTE))
+        {
+            failed++;
+            continue;
+        }
+        int cancelled = bench.client.request_ring("**610", "Door");
+        int answered = bench.client.request_ring("**611", "Door");
+        CHECK(cancelled >= 0 && answered >= 0 && cancelled != answered);
+        bool ok = bench.run_until([&] { return ringing() == 2; }, 20 * SECOND);
+        bench.client.request_cancel(cancelled);
+        ok &= bench.run_until([&] { return bench.has_event(SipClientEvent::Event::CALL_CANCELLED, cancelled); }, MINUTE);
+        ok &= bench.run_until([&] { return bench.has_event(SipClientEvent::Event::CALL_START, answered); }, MINUTE);
+        bench.run_for(SECOND);
+        bench.client.request_cancel(answered);
+        ok &= bench.run_until([&] { return bench.has_event(SipClientEvent::Event::CALL_END, answered); }, MINUTE);
+        ok &= !bench.has_event(SipClientEvent::Event::CALL_END, cancelled) && !bench.has_event(SipClientEvent::Event::CALL_CANCELLED, answered);
+
+        // the stand-in saw one call cancelled with 487 and one answered and ended with BYE
+        unsigned terminated = 0;
+        unsigned ended = 0;
+        for (auto& call : bench.server.calls())
+        {
+            terminated += call.second.final_status == "487 Request Terminated" && call.second.acked_at != 0;
+            ended += call.second.final_status == "200 OK" && call.second.acked_at != 0 && call.second.ended_at != 0;
+        }
+        ok &= terminated == 1 && ended == 1;
+        failed += !ok;
+        bench.run_for(5 * SECOND);
+        bench.server.forget_calls();
+        bench.events.clear();
+    }
+    const auto& counters = bench.server.counters();
+    printf("%-34s %5u rounds %3u failed | %5u INVITE  %4u CANCEL  %4u BYE\n", name, rounds, failed, counters.requests.at("INVITE"),
+           counters.requests.count("CANCEL") ? counters.requests.at("CANCEL") : 0, counters.requests.count("BYE") ? counters.requests.at("BYE") : 0);
+    CHECK(failed <= max_failed);
+    CHECK(counters.auth_failures == 0);
+}
+
+/**
+ * The link goes down while a call is requested, time from the link coming back until the
+ * next call rings
+ */
+static void outage(const char* name, unsigned long down_ms, unsigned long recovery_limit)
+{
+    Bench bench(99);
+    bench.network.configure(impairment(0.01));
+    CHECK(bench.call() >= 0);
+    bench.network.set_down(true);
+    bench.client.request_ring("**610", "Door");
+    bench.run_for(down_ms);
+    bench.network.set_down(false);
+    unsigned long up = bench.network.now;
+    long latency = bench.call();
+    long recovery = latency < 0 ? -1 : (long) (bench.last_trigger() - up) + latency;
+    printf("%-34s down %6lu ms | next call rang %ld ms after the link came back\n", name, down_ms, recovery);
+    CHECK(recovery >= 0 && (unsigned long) recovery <= recovery_limit);
+}
+
+int main()
+{
+    calls_under_loss("trigger->ringing, no loss", 0, 2000, 50, 0);
+    calls_under_loss("trigger->ringing, 5% loss", 0.05, 1000, 5 * SECOND, 0);
+    calls_under_loss("trigger->ringing, 20% loss", 0.2, 500, 16 * SECOND, 5);
+    parallel_calls("two calls, cancel one, no loss", 0, 200, 0);
+    parallel_calls("two calls, cancel one, 5% loss", 0.05, 200, 2);
+    refreshes("refreshes for 6 h, no loss", 0, 6 * HOUR, 0.9999);
+    refreshes("refreshes for 6 h, 20% loss", 0.2, 6 * HOUR, 0.99);
+    // a REGISTER retransmission waits up to T2 = 4 s, the call follows within a second or two
+    outage("outage 5 s", 5 * SECOND, 6 * SECOND);
+    outage("outage 60 s", MINUTE, 6 * SECOND);
+    outage("outage 10 min", 10 * MINUTE, 6 * SECOND);
+    if (s_failures != 0)
+    {
+        printf("%d checks failed\n", s_failures);
+        return 1;
+    }
+    printf("all scenarios passed\n");
+    return 0;
+}
@@ -0,0 +1,147 @@
+/**
+ * Header parsing of SipPacket: RFC 3261 compact forms and header names in any case
+ */
+#include "sip_client/sip_packet.h"
+
+#include <cstdio>
+#include <string>
+
+static int s_failures = 0;
+
+#define CHECK(condition)                                                          \
+    do {                                                                          \
+        if (!(condition)) {                                                       \
+            printf("  FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition);       \
+            s_failures++;                                                         \
+        }                                                                         \
+    } while (0)
+
+static void compact_headers()
+{
+    printf("compact header names\n");
+    std::string message =
+        "SIP/2.0 180 Ringing\r\n"
+        "v: SIP/2.0/UDP 192.168.178.50:5060;branch=z9hG4bK-1714636915;rport=5060\r\n"
+        "f: \"Door\" <sip:620@192.168.178.1>;tag=1681692777\r\n"
+        "t: <sip:**610@192.168.178.1>;tag=8C3A0D4E1F2B\r\n"
+        "i: 846930886@192.168.178.50\r\n"
+        "CSeq: 2 INVITE\r\n"
+        "m: <sip:**610@192.168.178.1:5060>;expires=120\r\n"
+        "c: application/dtmf-relay\r\n"
+        "l: 24\r\n"
+        "\r\n"
+        "Signal=5\r\n"
+        "Duration=160\r\n";
+    SipPacket packet(message.data(), message.size());
+    CHECK(packet.parse());
+    CHECK(packet.get_status() == SipPacket::Status::RINGING_180);
+    CHECK(packet.get_via() == "SIP/2.0/UDP 192.168.178.50:5060;branch=z9hG4bK-1714636915;rport=5060");
+    CHECK(packet.get_from_uri() == "sip:620@192.168.178.1");
+    CHECK(packet.get_from_tag() == "1681692777");
+    CHECK(packet.get_to_tag() == "8C3A0D4E1F2B");
+    CHECK(packet.get_call_id() == "846930886@192.168.178.50");
+    CHECK(packet.get_contact() == "sip:**610@192.168.178.1:5060");
+    CHECK(packet.get_contact_expires() == 120);
+    CHECK(packet.get_content_type() == SipPacket::ContentType::APPLICATION_DTMF_RELAY);
+    CHECK(packet.get_content_length() == 24);
+    CHECK(packet.get_dtmf_signal() == '5');
+    CHECK(packet.get_dtmf_duration() == 160);
+}
+
+static void header_name_case()
+{
+    printf("upper and mixed case header names\n");
+    std::string message =
+        "SIP/2.0 401 Unauthorized\r\n"
+        "VIA: SIP/2.0/UDP 192.168.178.50:5060;branch=z9hG4bK-1714636915;rport=5060\r\n"
+        "from: <sip:620@192.168.178.1>;tag=1681692777\r\n"
+        "TO: <sip:620@192.168.178.1>;tag=4F1E2D3C\r\n"
+        "call-id: 1804289383@192.168.178.50\r\n"
+        "cseq: 7 REGISTER\r\n"
+        "WWW-AUTHENTICATE: Digest realm=\"fritz.box\", nonce=\"7C9E2A41B3D5F687\", qop=\"auth\", opaque=\"0A1B\"\r\n"
+        "eXpIrEs: 300\r\n"
+        "MIN-expires: 60\r\n"
+        "Content-LENGTH: 0\r\n"
+        "\r\n";
+    SipPacket packet(message.data(), message.size());
+    CHECK(packet.parse());
+    CHECK(packet.get_status() == SipPacket::Status::UNAUTHORIZED_401);
+    CHECK(packet.get_via() == "SIP/2.0/UDP 192.168.178.50:5060;branch=z9hG4bK-1714636915;rport=5060");
+    CHECK(packet.get_from_tag() == "1681692777");
+    CHECK(packet.get_to_tag() == "4F1E2D3C");
+    CHECK(packet.get_call_id() == "1804289383@192.168.178.50");
+    CHECK(packet.get_cseq_number() == 7);
+    CHECK(packet.get_cseq_method() == SipPacket::Method::REGISTER);
+    CHECK(packet.get_realm() == "fritz.box");
+    CHECK(packet.get_nonce() == "7C9E2A41B3D5F687");
+    CHECK(packet.get_opaque() == "0A1B");
+    CHECK(packet.get_expires() == 300);
+    CHECK(packet.get_min_expires() == 60);
+    CHECK(packet.get_content_length() == 0);
+}
+
+static void similar_header_names()
+{
+    printf("header names that only look like known ones\n");
+    // same length, first and last character as known names, or a compact letter with more after it
+    std::string message =
+        "SIP/2.0 200 OK\r\n"
+        "Vxa: wrong\r\n"
+        "Form: wrong\r\n"
+        "Tx: wrong\r\n"
+        "Crrq: wrong\r\n"
+        "Call-ad: wrong\r\n"
+        "Contect: <sip:wrong@192.168.178.1>\r\n"
+        "ff: wrong\r\n"
+        "Proxy-Authorizatie: Digest nonce=\"wrong\"\r\n"
+        "Call-ID: 846930886@192.168.178.50\r\n"
+        "\r\n";
+    SipPacket packet(message.data(), message.size());
+    CHECK(packet.parse());
+    CHECK(packet.get_status() == SipPacket::Status::OK_200);
+    CHECK(packet.get_via().empty());
+    CHECK(packet.get_to().empty());
+    CHECK(packet.get_from().empty());
+    CHECK(packet.get_cseq().empty());
+    CHECK(packet.get_contact().empty());
+    CHECK(packet.get_nonce().empty());
+    CHECK(packet.get_call_id() == "846930886@192.168.178.50");
+}
+
+static void request_with_compact_headers()
+{
+    printf("request with compact header names\n");
+    std::string message =
+        "BYE sip:620@192.168.178.50:5060 SIP/2.0\r\n"
+        "V: SIP/2.0/UDP 192.168.178.1:5060;branch=z9hG4bK4C2E\r\n"
+        "F: <sip:**610@192.168.178.1>;tag=8C3A0D4E1F2B\r\n"
+        "T: \"Door\" <sip:620@192.168.178.1>;tag=1681692777\r\n"
+        "I: 846930886@192.168.178.50\r\n"
+        "cSeq: 3 BYE\r\n"
+        "L: 0\r\n"
+        "\r\n";
+    SipPacket packet(message.data(), message.size());
+    CHECK(packet.parse());
+    CHECK(!packet.is_response());
+    CHECK(packet.get_method() == SipPacket::Method::BYE);
+    CHECK(packet.get_via() == "SIP/2.0/UDP 192.168.178.1:5060;branch=z9hG4bK4C2E");
+    CHECK(packet.get_from_tag() == "8C3A0D4E1F2B");
+    CHECK(packet.get_to_tag() == "1681692777");
+    CHECK(packet.get_call_id() == "846930886@192.168.178.50");
+    CHECK(packet.get_cseq_method() == SipPacket::Method::BYE);
+}
+
+int main()
+{
+    compact_headers();
+    header_name_case();
+    similar_header_names();
+    request_with_compact_headers();
+    if (s_failures != 0)
+    {
+        printf("%d checks failed\n", s_failures);
+        return 1;
+    }
+    printf("all packet checks passed\n");
+    return 0;
+}
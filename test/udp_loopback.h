@@ -0,0 +1,67 @@
+#pragma once
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * UDP socket on localhost in front of a server stand-in
+ *
+ * Responses go back to the address the last request came from.
+ */
+template <class ServerT>
+class UdpLoopback
+{
+public:
+    explicit UdpLoopback(ServerT& server)
+    : m_server(server)
+    {
+    }
+
+    ~UdpLoopback()
+    {
+        if (m_fd >= 0)
+            close(m_fd);
+    }
+
+    bool open(uint16_t port)
+    {
+        m_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        if (m_fd < 0)
+            return false;
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        return bind(m_fd, (const sockaddr*) &address, sizeof(address)) == 0;
+    }
+
+    /**
+     * Pass the received requests to the stand-in and send the responses that are due
+     */
+    void exchange(unsigned long now)
+    {
+        char buffer[2048];
+        ssize_t length;
+        socklen_t client_length = sizeof(m_client);
+        while ((length = recvfrom(m_fd, buffer, sizeof(buffer), 0, (sockaddr*) &m_client, &client_length)) > 0)
+        {
+            m_server.receive(std::string_view(buffer, length), now);
+            client_length = sizeof(m_client);
+        }
+        std::string response;
+        while (m_server.poll(now, response))
+        {
+            sendto(m_fd, response.data(), response.size(), 0, (const sockaddr*) &m_client, sizeof(m_client));
+        }
+    }
+
+private:
+    ServerT& m_server;
+    int m_fd = -1;
+    sockaddr_in m_client = {};
+};